@@ -0,0 +1,244 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+/*
+	Benchmarks parsing, looking up and reading numbers from settings in KeyValueFile against the std::map parser it replaced,
+	using generated files from a handful of settings up to tens of thousands.
+	Every result is printed as one JSON object per line, the same as ScannerBenchmark.
+	Built by ConfigBenchmark.vcxproj on windows, elsewhere build it directly:
+		g++ -std=c++17 -O2 -I../H2ToolHooks ConfigBenchmark.cpp ../H2ToolHooks/Logger.cpp -pthread -o ConfigBenchmark
+*/
+
+#include "KeyValueConfig.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+struct Options
+{
+	std::vector<size_t> setting_counts = { 16, 10000 };
+	size_t iterations = 9;
+	uint32_t seed = 0x4F534F59;
+};
+
+/*
+	What KeyValueFile used to do, one std::string per line and two per setting
+*/
+static std::map<std::string, std::string> parse_legacy(const std::filesystem::path& path)
+{
+	std::map<std::string, std::string> key_value_pairs;
+	std::ifstream file(path);
+	while (file.good())
+	{
+		std::string line;
+		std::getline(file, line);
+
+		size_t cut_point = line.find_first_of('=');
+		if (cut_point == std::string::npos)
+			continue;
+
+		const auto trim = [](std::string_view str) {
+			const auto start = str.find_first_not_of(' ');
+			return start == std::string_view::npos ? std::string_view() : str.substr(start, str.find_last_not_of(' ') - start + 1);
+		};
+		key_value_pairs[std::string(trim(std::string_view(line).substr(0, cut_point)))] = trim(std::string_view(line).substr(cut_point + 1));
+	}
+	return key_value_pairs;
+}
+
+/*
+	What getNumber used to do, copy the value and let std::stoull throw if it isn't a number
+*/
+static bool get_number_legacy(const std::map<std::string, std::string>& key_value_pairs, const std::string& name, uint32_t& value)
+{
+	const auto found = key_value_pairs.find(name);
+	if (found == key_value_pairs.end())
+		return false;
+	const std::string copy = found->second;
+	try {
+		value = static_cast<uint32_t>(std::stoull(copy, 0, copy.size() >= 2 && copy[0] == '0' && copy[1] == 'x' ? 16 : 10));
+		return true;
+	}
+	catch (const std::invalid_argument&) {
+	}
+	catch (const std::out_of_range&) {
+	}
+	return false;
+}
+
+/*
+	Writes `count` settings in random order, a mix of numbers, booleans and paths like the real configuration files
+*/
+static std::vector<std::string> write_settings_file(const std::filesystem::path& path, size_t count, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::vector<std::string> names;
+	names.reserve(count);
+	for (size_t i = 0; i < count; i++)
+		names.push_back("setting_" + std::to_string(random() % 1000) + "_" + std::to_string(i));
+	std::shuffle(names.begin(), names.end(), random);
+
+	std::ofstream file(path);
+	for (size_t i = 0; i < names.size(); i++) {
+		file << names[i] << " = ";
+		switch (i % 3) {
+		case 0:
+			file << "0x" << std::hex << random() << std::dec;
+			break;
+		case 1:
+			file << (random() & 1 ? "true" : "false");
+			break;
+		default:
+			file << "C:\\Program Files\\Halo 2 Mod Tools\\tags\\scenarios\\multi\\map_" << random();
+			break;
+		}
+		file << "\n";
+	}
+	return names;
+}
+
+/*
+	Runs `benchmark` for each iteration and prints the timings, returns false if it didn't find every setting
+*/
+static bool run_benchmark(const Options& options, const char* name, size_t setting_count, size_t operations, size_t expected,
+	const std::function<size_t()>& benchmark)
+{
+	std::vector<double> times;
+	size_t found = 0;
+	for (size_t i = 0; i < options.iterations; i++) {
+		const auto start_time = std::chrono::steady_clock::now();
+		found = benchmark();
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count());
+	}
+	std::sort(times.begin(), times.end());
+	const double median = times[times.size() / 2];
+	const bool is_ok = found == expected;
+
+	printf("{\"benchmark\":\"%s\",\"settings\":%zu,\"iterations\":%zu,\"min_ms\":%.3f,\"median_ms\":%.3f,\"max_ms\":%.3f,"
+		"\"ns_per_op\":%.1f,\"found\":%zu,\"expected\":%zu,\"ok\":%s}\n",
+		name, setting_count, times.size(), times.front(), median, times.back(),
+		median * 1000000.0 / operations, found, expected, is_ok ? "true" : "false");
+	fflush(stdout);
+	return is_ok;
+}
+
+static bool benchmark_settings_file(const Options& options, size_t count)
+{
+	const auto path = std::filesystem::temp_directory_path() / ("ConfigBenchmark_" + std::to_string(count) + ".conf");
+	std::vector<std::string> names = write_settings_file(path, count, options.seed);
+	std::mt19937 random(options.seed);
+	std::shuffle(names.begin(), names.end(), random);
+
+	// a third of the settings are numbers, the rest fail to parse
+	const size_t number_count = (count + 2) / 3;
+
+	bool is_ok = true;
+	is_ok = run_benchmark(options, "parse_legacy", count, count, count, [&]() {
+		return parse_legacy(path).size();
+	}) && is_ok;
+	is_ok = run_benchmark(options, "parse", count, count, count, [&]() {
+		return KeyValueFile(path).get_setting_count();
+	}) && is_ok;
+
+	// every setting looked up once per iteration, in a different order to the file, with the name checked like getString does
+	const auto legacy = parse_legacy(path);
+	KeyValueFile file(path);
+	is_ok = run_benchmark(options, "lookup_legacy", count, count, count, [&]() {
+		size_t found = 0;
+		for (const auto& name : names)
+			found += file.is_setting_name_valid(name) && legacy.find(name) != legacy.end();
+		return found;
+	}) && is_ok;
+	is_ok = run_benchmark(options, "lookup", count, count, count, [&]() {
+		size_t found = 0;
+		std::string_view value;
+		for (const auto& name : names)
+			found += file.getString(name, value);
+		return found;
+	}) && is_ok;
+
+	// every setting read as a number, the first iteration parses them and fills the cache
+	is_ok = run_benchmark(options, "get_number_legacy", count, count, number_count, [&]() {
+		size_t found = 0;
+		uint32_t value;
+		for (const auto& name : names)
+			found += get_number_legacy(legacy, name, value);
+		return found;
+	}) && is_ok;
+	is_ok = run_benchmark(options, "get_number", count, count, number_count, [&]() {
+		size_t found = 0;
+		uint32_t value;
+		for (const auto& name : names)
+			found += file.tryGetNumber(name, value);
+		return found;
+	}) && is_ok;
+	is_ok = run_benchmark(options, "get_number_uncached", count, count, number_count, [&]() {
+		KeyValueFile uncached_file(path);
+		size_t found = 0;
+		uint32_t value;
+		for (const auto& name : names)
+			found += uncached_file.tryGetNumber(name, value);
+		return found;
+	}) && is_ok;
+
+	std::filesystem::remove(path);
+	return is_ok;
+}
+
+static void print_usage(const char* program)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  --settings <count>       settings in a generated file, can be repeated (default 16 and 10000)\n"
+		"  --iterations <count>     runs per benchmark, the median is reported (default 9)\n"
+		"  --seed <number>          seed for the generated files\n",
+		program);
+}
+
+// ConfigBenchmark [options], exits with 1 if a setting wasn't found
+int main(int argc, char* argv[])
+{
+	Options options;
+	bool default_counts = true;
+	for (int i = 1; i < argc; i += 2) {
+		const std::string argument = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		char* end = nullptr;
+		const unsigned long long number = value ? strtoull(value, &end, 0) : 0;
+		if (!value || *end != '\0') {
+			print_usage(argv[0]);
+			return 2;
+		}
+
+		if (argument == "--settings" && number > 0) {
+			if (default_counts)
+				options.setting_counts.clear();
+			default_counts = false;
+			options.setting_counts.push_back(static_cast<size_t>(number));
+		}
+		else if (argument == "--iterations" && number > 0) {
+			options.iterations = static_cast<size_t>(number);
+		}
+		else if (argument == "--seed") {
+			options.seed = static_cast<uint32_t>(number);
+		}
+		else {
+			print_usage(argv[0]);
+			return 2;
+		}
+	}
+
+	bool is_ok = true;
+	for (const size_t count : options.setting_counts)
+		is_ok = benchmark_settings_file(options, count) && is_ok;
+	return is_ok ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#include "AnchorPrefilter.h"
+#include <array>
+#include <cstring>
+
+// define ANCHOR_PREFILTER_SCALAR to test the portable code path
+#ifndef ANCHOR_PREFILTER_SCALAR
+#if defined(__AVX2__)
+#define ANCHOR_PREFILTER_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANCHOR_PREFILTER_SSE2 1
+#endif
+#endif
+
+#if ANCHOR_PREFILTER_AVX2 || ANCHOR_PREFILTER_SSE2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+/*
+	Bytes that show up a lot in 32-bit MSVC code, most common first.
+	Anything not in this list is treated as rare.
+*/
+static constexpr uint8_t common_x86_bytes[] = {
+	0x00, 0xFF, 0x8B, 0x89, 0x45, 0x24, 0xE8, 0x83, 0x04, 0x08,
+	0x01, 0x0F, 0x85, 0x50, 0x68, 0xC4, 0x8D, 0x10, 0x74, 0x75,
+	0x4D, 0x55, 0xEC, 0x5D, 0xC3, 0x33, 0xC0, 0x56, 0x57, 0x53,
+	0x5E, 0x5F, 0x5B, 0x0C, 0x14, 0x18, 0x84, 0xEB, 0x3B, 0x6A,
+	0x02, 0x20, 0xCC, 0x90, 0x46, 0x4E, 0x7D, 0xF8, 0xFC, 0x80
+};
+
+static constexpr std::array<uint8_t, 256> build_commonness_table()
+{
+	std::array<uint8_t, 256> table = {};
+	for (size_t i = 0; i < sizeof(common_x86_bytes); i++)
+		table[common_x86_bytes[i]] = static_cast<uint8_t>(sizeof(common_x86_bytes) - i);
+	return table;
+}
+
+static constexpr std::array<uint8_t, 256> commonness_table = build_commonness_table();
+
+uint8_t AnchorPrefilter::byte_commonness(uint8_t value)
+{
+	return commonness_table[value];
+}
+
+void AnchorPrefilter::add_literal(uint32_t offset, uint8_t value)
+{
+	const Anchor anchor = { offset, value };
+	const uint8_t commonness = byte_commonness(value);
+
+	if (anchor_count == 0) {
+		anchors[0] = anchor;
+		anchor_count = 1;
+	}
+	else if (commonness < byte_commonness(anchors[0].value)) {
+		anchors[1] = anchors[0];
+		anchors[0] = anchor;
+		anchor_count = 2;
+	}
+	else if (anchor_count == 1 || commonness < byte_commonness(anchors[1].value)) {
+		anchors[1] = anchor;
+		anchor_count = 2;
+	}
+
+	if (current_run.length == 0 || offset != current_run.offset + current_run.length || current_run.length == max_skip_run) {
+		current_run.offset = offset;
+		current_run.length = 0;
+	}
+	current_run.bytes[current_run.length++] = value;
+	if (current_run.length > longest_run.length)
+		longest_run = current_run;
+}
+
+void AnchorPrefilter::build_skip_table()
+{
+	if (longest_run.length < min_skip_run)
+		return;
+
+	// standard Horspool table, the shift for a byte is the distance from its last occurrence to the end of the run
+	const uint32_t last_index = longest_run.length - 1;
+	memset(skip_table, static_cast<int>(longest_run.length), sizeof(skip_table));
+	for (uint32_t i = 0; i < last_index; i++)
+		skip_table[longest_run.bytes[i]] = static_cast<uint8_t>(last_index - i);
+}
+
+const uint8_t* AnchorPrefilter::next_candidate_after(const uint8_t* candidate, const uint8_t* last) const
+{
+	// whatever is under the end of the run rules out every alignment before the skip, whether or not this one matched
+	if (skip_table[0] != 0)
+		return next_candidate(candidate + skip_table[candidate[longest_run.offset + longest_run.length - 1]], last);
+	return next_candidate(candidate + 1, last);
+}
+
+#if ANCHOR_PREFILTER_AVX2 || ANCHOR_PREFILTER_SSE2
+static inline uint32_t lowest_set_bit(uint32_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+const char* AnchorPrefilter::get_search_loop()
+{
+#if ANCHOR_PREFILTER_AVX2
+	return "avx2";
+#elif ANCHOR_PREFILTER_SSE2
+	return "sse2";
+#else
+	return "memchr";
+#endif
+}
+
+const uint8_t* AnchorPrefilter::next_candidate(const uint8_t* position, const uint8_t* last) const
+{
+	if (position >= last)
+		return last;
+	if (anchor_count == 0)
+		return position;
+
+	// with only one anchor just compare it twice
+	const Anchor& first = anchors[0];
+	const Anchor& second = anchors[anchor_count - 1];
+
+#if ANCHOR_PREFILTER_AVX2
+	const __m256i first_value_wide = _mm256_set1_epi8(static_cast<char>(first.value));
+	const __m256i second_value_wide = _mm256_set1_epi8(static_cast<char>(second.value));
+	while (last - position >= 32) {
+		const __m256i first_data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(position + first.offset));
+		const __m256i second_data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(position + second.offset));
+		const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi8(first_data, first_value_wide),
+			_mm256_cmpeq_epi8(second_data, second_value_wide))));
+		if (mask != 0)
+			return position + lowest_set_bit(mask);
+		position += 32;
+	}
+#endif
+
+#if ANCHOR_PREFILTER_SSE2
+	const __m128i first_value = _mm_set1_epi8(static_cast<char>(first.value));
+	const __m128i second_value = _mm_set1_epi8(static_cast<char>(second.value));
+	while (last - position >= 16) {
+		const __m128i first_data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position + first.offset));
+		const __m128i second_data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position + second.offset));
+		const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(first_data, first_value),
+			_mm_cmpeq_epi8(second_data, second_value))));
+		if (mask != 0)
+			return position + lowest_set_bit(mask);
+		position += 16;
+	}
+#endif
+
+	// portable fallback, also handles the tail the vector loops can't
+	while (position < last) {
+		const void* found = memchr(position + first.offset, first.value, last - position);
+		if (!found)
+			return last;
+		position = reinterpret_cast<const uint8_t*>(found) - first.offset;
+		if (matches_anchors(position))
+			return position;
+		position++;
+	}
+	return last;
+}
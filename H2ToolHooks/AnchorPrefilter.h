@@ -0,0 +1,92 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/*
+	Finds the positions a pattern could start at by only looking for the rarest literal bytes in it.
+	Doesn't depend on anything windows specific so it can be used on any byte buffer.
+*/
+class AnchorPrefilter
+{
+public:
+	/*
+		Register a byte the pattern requires at `offset` from the start of the match, in order of offset
+	*/
+	void add_literal(uint32_t offset, uint8_t value);
+
+	/*
+		Call once all the literals are added, builds the skip table if the pattern has a long enough run of literal bytes
+	*/
+	void build_skip_table();
+
+	/*
+		Returns true if this pattern has any literal bytes to search for
+	*/
+	bool has_anchor() const {
+		return anchor_count != 0;
+	}
+
+	/*
+		Returns the first position in [`position`, `last`) a match could start at, or `last` if there is none.
+		The bytes at every anchor offset from the positions searched must be readable.
+	*/
+	const uint8_t* next_candidate(const uint8_t* position, const uint8_t* last) const;
+
+	/*
+		Same as next_candidate for the positions after `candidate`, skips the ones the literal run can't be at
+	*/
+	const uint8_t* next_candidate_after(const uint8_t* candidate, const uint8_t* last) const;
+
+	/*
+		How common a byte is in x86 code, lower is rarer
+	*/
+	static uint8_t byte_commonness(uint8_t value);
+
+	/*
+		Which search loop was compiled in, "avx2", "sse2" or "memchr"
+	*/
+	static const char* get_search_loop();
+
+private:
+	struct Anchor
+	{
+		uint32_t offset;
+		uint8_t value;
+	};
+
+	bool matches_anchors(const uint8_t* position) const {
+		for (size_t i = 0; i < anchor_count; i++) {
+			if (position[anchors[i].offset] != anchors[i].value)
+				return false;
+		}
+		return true;
+	}
+
+	// the first anchor is the rarest and is the one searched for, the second is used to thin the candidates out
+	Anchor anchors[2] = {};
+	size_t anchor_count = 0;
+
+	/*
+		Boyer-Moore-Horspool skip table for the longest run of consecutive literal bytes.
+		It's only used to move on from a candidate, scanning for the anchors is faster than skipping between them.
+	*/
+	static constexpr uint32_t min_skip_run = 4;
+	static constexpr uint32_t max_skip_run = 64;
+
+	struct LiteralRun
+	{
+		uint32_t offset;
+		uint32_t length;
+		uint8_t bytes[max_skip_run];
+	};
+	LiteralRun longest_run = {};
+	LiteralRun current_run = {};
+	// how far the run can move when the byte under its last position is the index, zero if there's no table
+	uint8_t skip_table[256] = {};
+};
@@ -0,0 +1,462 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#include "BytecodePattern.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+/*
+	Builds up the instruction stream, runs of literal bytes and wildcards are merged into one instruction
+*/
+class BytecodeWriter
+{
+public:
+	BytecodeWriter(std::vector<uint32_t>& code) :
+		code(code)
+	{}
+
+	void add_literal(uint8_t value) {
+		flush_any();
+		pending_bytes.push_back(value);
+	}
+
+	void add_any(size_t count) {
+		flush_bytes();
+		pending_any += count;
+	}
+
+	void add_instruction(uint32_t instruction, std::initializer_list<uint32_t> operands) {
+		flush();
+		code.push_back(instruction);
+		code.insert(code.end(), operands);
+	}
+
+	void flush() {
+		flush_bytes();
+		flush_any();
+	}
+
+private:
+	void flush_bytes() {
+		if (pending_bytes.empty())
+			return;
+		code.push_back(BytecodePattern::encode(BytecodePattern::op_bytes, static_cast<uint32_t>(pending_bytes.size())));
+		const size_t first_word = code.size();
+		code.resize(first_word + (pending_bytes.size() + 3) / 4, 0);
+		memcpy(&code[first_word], pending_bytes.data(), pending_bytes.size());
+		pending_bytes.clear();
+	}
+
+	void flush_any() {
+		if (pending_any == 0)
+			return;
+		code.push_back(BytecodePattern::encode(BytecodePattern::op_any, static_cast<uint32_t>(pending_any)));
+		pending_any = 0;
+	}
+
+	std::vector<uint32_t>& code;
+	std::vector<uint8_t> pending_bytes;
+	size_t pending_any = 0;
+};
+
+static bool parse_integer(std::string_view text, int64_t& value)
+{
+	const std::string terminated(text);
+	char* end;
+	errno = 0;
+	value = strtoll(terminated.c_str(), &end, 0);
+	return !terminated.empty() && *end == '\0' && errno == 0;
+}
+
+struct IntegerType
+{
+	const char* name;
+	uint32_t size;
+	bool is_signed;
+};
+
+static constexpr IntegerType integer_types[] = {
+	{ "u8", 1, false },
+	{ "u16", 2, false },
+	{ "u32", 4, false },
+	{ "i8", 1, true },
+	{ "i16", 2, true },
+	{ "i32", 4, true },
+};
+
+static const IntegerType* find_integer_type(std::string_view name)
+{
+	for (const auto& type : integer_types) {
+		if (name == type.name)
+			return &type;
+	}
+	return nullptr;
+}
+
+static bool fits_integer_type(const IntegerType& type, int64_t value)
+{
+	const int bits = type.size * 8;
+	if (type.is_signed)
+		return value >= -(int64_t(1) << (bits - 1)) && value < (int64_t(1) << (bits - 1));
+	return value >= 0 && value < (int64_t(1) << bits);
+}
+
+std::optional<BytecodePattern> BytecodePattern::compile(std::string_view text, const symbol_table& symbols, std::string& error)
+{
+	BytecodePattern pattern;
+	BytecodeWriter writer(pattern.code);
+
+	size_t position = 0;
+	while (true) {
+		while (position < text.size() && isspace(static_cast<unsigned char>(text[position])))
+			position++;
+		if (position >= text.size())
+			break;
+
+		// comments run to the end of the line
+		if (text[position] == '#') {
+			while (position < text.size() && text[position] != '\n')
+				position++;
+			continue;
+		}
+
+		// the same as a string, but RIP-relative
+		const bool is_rip_relative = text.substr(position, 5) == "rip:\"";
+		if (is_rip_relative)
+			position += 4;
+
+		if (text[position] == '"') {
+			std::string string;
+			size_t end = position + 1;
+			for (; end < text.size() && text[end] != '"'; end++) {
+				if (text[end] == '\\' && end + 1 < text.size())
+					end++;
+				string += text[end];
+			}
+			if (end >= text.size()) {
+				error = "unterminated string";
+				return std::optional<BytecodePattern>{};
+			}
+			// the empty string is at the end of every other string, it would match almost any pointer into rdata
+			if (string.empty()) {
+				error = "empty string";
+				return std::optional<BytecodePattern>{};
+			}
+			writer.add_instruction(encode(is_rip_relative ? op_rip_string : op_string, sizeof(uint32_t)), { static_cast<uint32_t>(pattern.strings.size()) });
+			pattern.strings.push_back(string);
+			pattern.size += sizeof(uint32_t);
+			position = end + 1;
+			continue;
+		}
+
+		size_t end = position;
+		while (end < text.size() && !isspace(static_cast<unsigned char>(text[end])) && text[end] != '#')
+			end++;
+		const std::string_view token = text.substr(position, end - position);
+		position = end;
+
+		if (token == "?" || token == "??") {
+			writer.add_any(1);
+			pattern.size += 1;
+			continue;
+		}
+
+		if (token.size() == 2 && isxdigit(static_cast<unsigned char>(token[0])) && isxdigit(static_cast<unsigned char>(token[1]))) {
+			writer.add_literal(static_cast<uint8_t>(strtoul(std::string(token).c_str(), nullptr, 16)));
+			pattern.size += 1;
+			continue;
+		}
+
+		if (token.front() == '[') {
+			const size_t close = token.find(']');
+			const size_t separator = token.find("..");
+			if (close == std::string_view::npos || separator == std::string_view::npos || separator > close) {
+				error = "bad range '" + std::string(token) + "'";
+				return std::optional<BytecodePattern>{};
+			}
+
+			const IntegerType* type = find_integer_type("u32");
+			if (close + 1 < token.size()) {
+				if (token[close + 1] != ':' || !(type = find_integer_type(token.substr(close + 2)))) {
+					error = "bad range type in '" + std::string(token) + "'";
+					return std::optional<BytecodePattern>{};
+				}
+			}
+
+			int64_t lower, upper;
+			if (!parse_integer(token.substr(1, separator - 1), lower) || !parse_integer(token.substr(separator + 2, close - separator - 2), upper)
+				|| !fits_integer_type(*type, lower) || !fits_integer_type(*type, upper) || lower > upper) {
+				error = "bad range bounds in '" + std::string(token) + "'";
+				return std::optional<BytecodePattern>{};
+			}
+
+			const Opcode opcodes[] = { op_range_u8, op_range_u16, op_range_u32, op_range_i8, op_range_i16, op_range_i32 };
+			writer.add_instruction(encode(opcodes[type - integer_types], type->size), { static_cast<uint32_t>(lower), static_cast<uint32_t>(upper) });
+			pattern.size += type->size;
+			continue;
+		}
+
+		const size_t colon = token.find(':');
+		if (colon == std::string_view::npos) {
+			error = "unknown token '" + std::string(token) + "'";
+			return std::optional<BytecodePattern>{};
+		}
+		const std::string_view prefix = token.substr(0, colon);
+		const std::string_view argument = token.substr(colon + 1);
+
+		if (prefix == "call" || prefix == "jmp") {
+			image_address target;
+			if (!argument.empty() && isdigit(static_cast<unsigned char>(argument[0]))) {
+				const std::string terminated(argument);
+				char* number_end;
+				errno = 0;
+				target = strtoull(terminated.c_str(), &number_end, 0);
+				if (*number_end != '\0' || errno != 0) {
+					error = "bad " + std::string(prefix) + " target '" + terminated + "'";
+					return std::optional<BytecodePattern>{};
+				}
+			}
+			else {
+				const auto symbol = symbols.find(std::string(argument));
+				if (symbol == symbols.end()) {
+					error = "unknown symbol '" + std::string(argument) + "'";
+					return std::optional<BytecodePattern>{};
+				}
+				target = symbol->second;
+			}
+			writer.add_instruction(encode(prefix == "call" ? op_call : op_jump, 5), { static_cast<uint32_t>(target), static_cast<uint32_t>(target >> 32) });
+			pattern.size += 5;
+			continue;
+		}
+
+		uint8_t bytes[sizeof(uint32_t)];
+		uint32_t byte_count;
+		if (prefix == "f32") {
+			const std::string terminated(argument);
+			char* number_end;
+			const float value = strtof(terminated.c_str(), &number_end);
+			if (terminated.empty() || *number_end != '\0') {
+				error = "bad float '" + terminated + "'";
+				return std::optional<BytecodePattern>{};
+			}
+			memcpy(bytes, &value, sizeof(value));
+			byte_count = sizeof(value);
+		}
+		else if (const IntegerType* type = find_integer_type(prefix)) {
+			int64_t value;
+			if (!parse_integer(argument, value) || !fits_integer_type(*type, value)) {
+				error = "bad " + std::string(prefix) + " value '" + std::string(argument) + "'";
+				return std::optional<BytecodePattern>{};
+			}
+			const uint32_t truncated = static_cast<uint32_t>(value);
+			memcpy(bytes, &truncated, sizeof(truncated));
+			byte_count = type->size;
+		}
+		else {
+			error = "unknown token '" + std::string(token) + "'";
+			return std::optional<BytecodePattern>{};
+		}
+
+		for (uint32_t i = 0; i < byte_count; i++)
+			writer.add_literal(bytes[i]);
+		pattern.size += byte_count;
+	}
+	writer.flush();
+
+	// wildcards and ranges on their own match nearly everywhere, there has to be something to look for
+	bool is_anchored = false;
+	for (const uint32_t* instruction = pattern.code.data(); instruction < pattern.code.data() + pattern.code.size(); instruction += instruction_words(instruction)) {
+		const Opcode opcode = opcode_of(*instruction);
+		is_anchored = is_anchored || opcode == op_bytes || opcode == op_call || opcode == op_jump || opcode == op_string || opcode == op_rip_string;
+		pattern.element_count++;
+	}
+
+	if (pattern.size == 0) {
+		error = "empty pattern";
+		return std::optional<BytecodePattern>{};
+	}
+	if (!is_anchored) {
+		error = "pattern has no literal bytes, call, jmp or string to anchor it";
+		return std::optional<BytecodePattern>{};
+	}
+	return pattern;
+}
+
+template <typename T>
+static inline bool in_range(const uint8_t* data, const uint32_t* bounds)
+{
+	T value, lower, upper;
+	memcpy(&value, data, sizeof(T));
+	lower = static_cast<T>(bounds[0]);
+	upper = static_cast<T>(bounds[1]);
+	return lower <= value && value <= upper;
+}
+
+static inline image_address read_address(const uint32_t* operands)
+{
+	return operands[0] | (image_address(operands[1]) << 32);
+}
+
+size_t BytecodePattern::find_rejecting_element(const PatternScanner& scanner, const uint8_t* data, image_address address) const
+{
+	const uint32_t* instruction = code.data();
+	const uint32_t* end = instruction + code.size();
+	for (size_t element = 0; instruction < end; element++) {
+		const uint32_t element_size = size_of(*instruction);
+		const uint32_t* operands = instruction + 1;
+
+		switch (opcode_of(*instruction)) {
+		case op_bytes:
+			if (memcmp(data, operands, element_size) != 0)
+				return element;
+			break;
+		case op_any:
+			break;
+		case op_call:
+		case op_jump: {
+			if (*data != (opcode_of(*instruction) == op_call ? 0xE8 : 0xE9))
+				return element;
+			int32_t displacement;
+			memcpy(&displacement, data + 1, sizeof(displacement));
+			if (address + 5 + displacement != read_address(operands))
+				return element;
+			break;
+		}
+		case op_string: {
+			uint32_t pointer;
+			memcpy(&pointer, data, sizeof(pointer));
+			if (!scanner.is_string_at(pointer, strings[operands[0]].c_str()))
+				return element;
+			break;
+		}
+		case op_string_resolved: {
+			uint32_t pointer;
+			memcpy(&pointer, data, sizeof(pointer));
+			const uint32_t address_count = operands[1];
+			if (address_count == 0 && !scanner.is_string_at(pointer, strings[operands[0]].c_str()))
+				return element;
+			if (address_count != 0 && std::find(operands + 2, operands + 2 + address_count, pointer) == operands + 2 + address_count)
+				return element;
+			break;
+		}
+		case op_rip_string: {
+			if (!scanner.is_string_at(PatternElement::RipRelativeStringXREF::get_target(data, address), strings[operands[0]].c_str()))
+				return element;
+			break;
+		}
+		case op_rip_string_resolved: {
+			const image_address target = PatternElement::RipRelativeStringXREF::get_target(data, address);
+			const uint32_t address_count = operands[1];
+			if (address_count == 0 && !scanner.is_string_at(target, strings[operands[0]].c_str()))
+				return element;
+			if (address_count != 0) {
+				uint32_t i = 0;
+				while (i < address_count && read_address(operands + 2 + i * 2) != target)
+					i++;
+				if (i == address_count)
+					return element;
+			}
+			break;
+		}
+		case op_range_u8:
+			if (!in_range<uint8_t>(data, operands))
+				return element;
+			break;
+		case op_range_u16:
+			if (!in_range<uint16_t>(data, operands))
+				return element;
+			break;
+		case op_range_u32:
+			if (!in_range<uint32_t>(data, operands))
+				return element;
+			break;
+		case op_range_i8:
+			if (!in_range<int8_t>(data, operands))
+				return element;
+			break;
+		case op_range_i16:
+			if (!in_range<int16_t>(data, operands))
+				return element;
+			break;
+		case op_range_i32:
+			if (!in_range<int32_t>(data, operands))
+				return element;
+			break;
+		}
+
+		data += element_size;
+		address += element_size;
+		instruction += instruction_words(instruction);
+	}
+	return element_count;
+}
+
+bool BytecodePattern::find_call_element(size_t& offset, image_address& target) const
+{
+	size_t element_offset = 0;
+	for (const uint32_t* instruction = code.data(); instruction < code.data() + code.size(); instruction += instruction_words(instruction)) {
+		if (opcode_of(*instruction) == op_call) {
+			offset = element_offset;
+			target = read_address(instruction + 1);
+			return true;
+		}
+		element_offset += size_of(*instruction);
+	}
+	return false;
+}
+
+bool BytecodePattern::find_unanchored_rdata_pointer(size_t& offset) const
+{
+	size_t element_offset = 0;
+	for (const uint32_t* instruction = code.data(); instruction < code.data() + code.size(); instruction += instruction_words(instruction)) {
+		const Opcode opcode = opcode_of(*instruction);
+		if (opcode == op_string || (opcode == op_string_resolved && instruction[2] != 1)) {
+			offset = element_offset;
+			return true;
+		}
+		element_offset += size_of(*instruction);
+	}
+	return false;
+}
+
+BytecodePattern BytecodePattern::resolve(const PatternScanner& scanner) const
+{
+	BytecodePattern resolved;
+	resolved.strings = strings;
+	resolved.size = size;
+	resolved.element_count = element_count;
+	resolved.code.reserve(code.size() + strings.size() * (2 + max_string_addresses * 2));
+
+	for (const uint32_t* instruction = code.data(); instruction < code.data() + code.size(); instruction += instruction_words(instruction)) {
+		const Opcode opcode = opcode_of(*instruction);
+		if (opcode != op_string && opcode != op_rip_string) {
+			resolved.code.insert(resolved.code.end(), instruction, instruction + instruction_words(instruction));
+			continue;
+		}
+
+		// a 32-bit pointer can only reach the copies below 4GB
+		std::vector<image_address> addresses;
+		for (image_address address : scanner.find_string_addresses(strings[instruction[1]].c_str())) {
+			if (opcode == op_rip_string || address <= UINT32_MAX)
+				addresses.push_back(address);
+		}
+
+		// more copies than fit are left to compare the string, which is marked by a count of zero
+		const size_t address_count = addresses.size() <= max_string_addresses ? addresses.size() : 0;
+		resolved.code.push_back(encode(opcode == op_string ? op_string_resolved : op_rip_string_resolved, sizeof(uint32_t)));
+		resolved.code.push_back(instruction[1]);
+		resolved.code.push_back(static_cast<uint32_t>(address_count));
+		for (size_t i = 0; i < address_count; i++) {
+			resolved.code.push_back(static_cast<uint32_t>(addresses[i]));
+			if (opcode == op_rip_string)
+				resolved.code.push_back(static_cast<uint32_t>(addresses[i] >> 32));
+		}
+	}
+	return resolved;
+}
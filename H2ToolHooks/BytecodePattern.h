@@ -0,0 +1,164 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#pragma once
+#include "PatternScanner.h"
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+	A pattern compiled at runtime from text, so signatures can be kept in a data file instead of being built into the code.
+	Tokens are separated by whitespace:
+		8B 45          literal bytes in hex
+		?? or ?        any byte
+		"string"       absolute address of a copy of the string in rdata, like PAT_STRING_XREF
+		call:target    call rel32 to an address or to a name looked up in the symbols given to compile, jmp:target for a jmp rel32
+		rip:"string"   disp32 of a RIP-relative operand pointing at a copy of the string, like PAT_RIP_STRING_XREF
+		[low..high]    little-endian integer in the range, 32-bit unsigned unless followed by :u8/:u16/:i8/:i16/:i32
+		i32:value      the bytes of a little-endian value, also u8/u16/u32/i8/i16 and f32
+	Strings can't be empty, and a pattern of nothing but wildcards and ranges is rejected since it would match nearly everywhere.
+	The elements are compiled to one flat array of words, each an opcode and element size followed by its operands.
+	It can be passed to every PatternScanner search the same way a Pattern can.
+*/
+class BytecodePattern
+{
+public:
+	typedef std::unordered_map<std::string, image_address> symbol_table;
+
+	/*
+		Compiles `text`, on failure nothing is returned and `error` says why
+	*/
+	static std::optional<BytecodePattern> compile(std::string_view text, const symbol_table& symbols, std::string& error);
+
+	size_t get_size() const {
+		return size;
+	}
+
+	/*
+		Number of instructions, a run of literal bytes or wildcards counts as one element
+	*/
+	size_t get_element_count() const {
+		return element_count;
+	}
+
+	bool matches(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+		return find_rejecting_element(scanner, data, address) == element_count;
+	}
+
+	/*
+		Returns the index of the first instruction that doesn't match, or the element count if they all do
+	*/
+	size_t find_rejecting_element(const PatternScanner& scanner, const uint8_t* data, image_address address) const;
+
+	template <typename Callback>
+	void for_each_literal(Callback&& callback) const {
+		size_t offset = 0;
+		for (const uint32_t* instruction = code.data(); instruction < code.data() + code.size(); instruction += instruction_words(instruction)) {
+			const Opcode opcode = opcode_of(*instruction);
+			if (opcode == op_bytes) {
+				const uint8_t* bytes = reinterpret_cast<const uint8_t*>(instruction + 1);
+				for (size_t i = 0; i < size_of(*instruction); i++)
+					callback(offset + i, bytes[i]);
+			}
+			else if (opcode == op_call || opcode == op_jump) {
+				callback(offset, opcode == op_call ? 0xE8 : 0xE9);
+			}
+			else if (opcode == op_string_resolved && instruction[2] == 1) {
+				// with only one copy of the string the reference is a fixed value
+				const uint8_t* bytes = reinterpret_cast<const uint8_t*>(instruction + 3);
+				for (size_t i = 0; i < sizeof(uint32_t); i++)
+					callback(offset + i, bytes[i]);
+			}
+			offset += size_of(*instruction);
+		}
+	}
+
+	/*
+		Same as Pattern::find_call_element and Pattern::find_unanchored_rdata_pointer
+	*/
+	bool find_call_element(size_t& offset, image_address& target) const;
+	bool find_unanchored_rdata_pointer(size_t& offset) const;
+
+	/*
+		Returns a copy with the string references replaced by the addresses of the strings
+	*/
+	BytecodePattern resolve(const PatternScanner& scanner) const;
+
+private:
+	friend class BytecodeWriter;
+
+	enum Opcode : uint8_t
+	{
+		// operands: the bytes, packed into words
+		op_bytes,
+		// no operands
+		op_any,
+		// operands: target low and high words
+		op_call,
+		op_jump,
+		// operands: string index
+		op_string,
+		// operands: string index, address count, 32-bit addresses
+		op_string_resolved,
+		// operands: string index
+		op_rip_string,
+		// operands: string index, address count, 64-bit addresses as low and high words
+		op_rip_string_resolved,
+		// operands: low, high
+		op_range_u8,
+		op_range_u16,
+		op_range_u32,
+		op_range_i8,
+		op_range_i16,
+		op_range_i32,
+	};
+
+	static constexpr size_t max_string_addresses = 4;
+
+	static uint32_t encode(Opcode opcode, uint32_t element_size) {
+		return opcode | (element_size << 8);
+	}
+
+	static Opcode opcode_of(uint32_t instruction) {
+		return static_cast<Opcode>(instruction & 0xFF);
+	}
+
+	static uint32_t size_of(uint32_t instruction) {
+		return instruction >> 8;
+	}
+
+	/*
+		Number of words taken by the instruction at `instruction`, including the opcode
+	*/
+	static size_t instruction_words(const uint32_t* instruction) {
+		switch (opcode_of(*instruction)) {
+		case op_bytes:
+			return 1 + (size_of(*instruction) + 3) / 4;
+		case op_any:
+			return 1;
+		case op_string:
+		case op_rip_string:
+			return 2;
+		case op_call:
+		case op_jump:
+			return 3;
+		case op_string_resolved:
+			return 3 + instruction[2];
+		case op_rip_string_resolved:
+			return 3 + instruction[2] * 2;
+		default:
+			return 3;
+		}
+	}
+
+	std::vector<uint32_t> code;
+	std::vector<std::string> strings;
+	size_t size = 0;
+	size_t element_count = 0;
+};
@@ -1,18 +1,39 @@
 #pragma once
 #include "platform.h"
-#include <stdio.h>
+#include "Logger.h"
 
-inline static void DebugPrintf(
-    _In_z_ _Printf_format_string_ const char* fmt, ...)
-{
-    va_list ArgList;
-    va_start(ArgList, fmt);
+/*
+	Messages below LOG_LEVEL are compiled out, arguments and all. Debug in debug builds and Info otherwise,
+	define LOG_LEVEL as Debug, Info, Warning or Error to override.
+*/
+#ifndef LOG_LEVEL
+#ifdef _DEBUG
+#define LOG_LEVEL Debug
+#else
+#define LOG_LEVEL Info
+#endif
+#endif
 
-    char message[0x1000];
+/*
+	Define LOG_DEFERRED_FORMAT as 1 to store the format string and a copy of the arguments instead of formatting
+	messages as they are logged, the drain thread formats them instead. Format strings have to be literals.
+*/
+#ifndef LOG_DEFERRED_FORMAT
+#define LOG_DEFERRED_FORMAT 0
+#endif
 
-    vsprintf_s(message, fmt, ArgList);
-    strcat_s(message, "\n");
+#if LOG_DEFERRED_FORMAT
+#define LOG_WRITE(level, ...) Logger::global().write_deferred(level, __VA_ARGS__)
+#else
+#define LOG_WRITE(level, ...) Logger::global().write(level, __VA_ARGS__)
+#endif
 
-    printf("%s", message);
-    OutputDebugStringA(message);
-}
+#define LOG_AT(level, ...) do { \
+		if constexpr (LogLevel::level >= LogLevel::LOG_LEVEL) \
+			LOG_WRITE(LogLevel::level, __VA_ARGS__); \
+	} while (0)
+
+#define LOG_DEBUG(...) LOG_AT(Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(Info, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(Warning, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(Error, __VA_ARGS__)
@@ -0,0 +1,153 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#include "ExportResolver.h"
+#include <algorithm>
+#include <cctype>
+
+static std::string to_lower(std::string_view string)
+{
+	std::string lower(string);
+	std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return lower;
+}
+
+ExportResolver::ExportResolver(std::vector<std::filesystem::path> search_paths) :
+	search_paths(std::move(search_paths))
+{}
+
+std::optional<std::filesystem::path> ExportResolver::find_module_file(std::string_view name, const Module* referrer) const
+{
+	std::error_code error;
+	std::filesystem::path file_name = std::filesystem::u8path(name);
+	// anything with a directory in it is taken as it is
+	if (file_name.has_parent_path())
+		return std::filesystem::is_regular_file(file_name, error) ? std::optional<std::filesystem::path>(file_name) : std::nullopt;
+	if (!file_name.has_extension())
+		file_name += ".dll";
+
+	std::vector<std::filesystem::path> directories;
+	if (referrer)
+		directories.push_back(referrer->path.parent_path());
+	directories.insert(directories.end(), search_paths.begin(), search_paths.end());
+	if (directories.empty())
+		directories.push_back(std::filesystem::current_path(error));
+
+	const std::string lower_name = to_lower(file_name.u8string());
+	for (const auto& directory : directories) {
+		const std::filesystem::path path = directory / file_name;
+		if (std::filesystem::is_regular_file(path, error))
+			return path;
+		// windows doesn't care about case, so neither do the names DLLs use for each other
+		for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+			if (to_lower(it->path().filename().u8string()) == lower_name && it->is_regular_file(error))
+				return it->path();
+		}
+		error.clear();
+	}
+	return std::nullopt;
+}
+
+ExportResolver::Module* ExportResolver::load_module(std::string_view name, const Module* referrer, std::string& error)
+{
+	std::string name_key = to_lower(name);
+	if (referrer)
+		name_key += "|" + to_lower(referrer->path.parent_path().u8string());
+	const auto cached_name = module_names.find(name_key);
+	if (cached_name != module_names.end())
+		return cached_name->second;
+
+	const auto path = find_module_file(name, referrer);
+	if (!path) {
+		error = "couldn't find " + std::string(name);
+		// API sets are mapped to DLLs by a schema in the running system, there is no file to find
+		if (name.size() >= 4 && (to_lower(name.substr(0, 4)) == "api-" || to_lower(name.substr(0, 4)) == "ext-"))
+			error += ", API sets can't be resolved from disk";
+		return nullptr;
+	}
+
+	std::error_code path_error;
+	const std::filesystem::path absolute_path = std::filesystem::absolute(*path, path_error);
+	const std::string path_key = to_lower((path_error ? *path : absolute_path).u8string());
+	auto& module = modules[path_key];
+	if (!module) {
+		module = std::make_unique<Module>(*path);
+		if (module->file.is_open())
+			module->image = PEImage::parse(module->file.data(), module->file.size(), false);
+		if (module->image)
+			module->exports = PEExports::parse(*module->image);
+	}
+
+	if (!module->file.is_open()) {
+		error = "couldn't open " + path->u8string();
+		return nullptr;
+	}
+	if (!module->image) {
+		error = path->u8string() + " isn't a PE image";
+		return nullptr;
+	}
+	if (!module->exports) {
+		error = path->u8string() + " has a malformed export directory";
+		return nullptr;
+	}
+
+	module_names[name_key] = module.get();
+	return module.get();
+}
+
+ExportResolver::Result ExportResolver::resolve(std::string_view module_name, std::string_view symbol)
+{
+	Result result;
+	const Module* referrer = nullptr;
+	for (size_t depth = 0; depth <= max_forwarder_depth; depth++) {
+		const Module* module = load_module(module_name, referrer, result.error);
+		if (!module)
+			return result;
+
+		const PEExports::Export* entry = module->exports->find_symbol(symbol);
+		if (!entry) {
+			result.error = std::string(symbol) + " isn't exported by " + module->path.filename().u8string();
+			return result;
+		}
+		if (entry->forwarder.empty()) {
+			result.module = module->path;
+			result.rva = entry->rva;
+			return result;
+		}
+
+		// `MODULE.Name` or `MODULE.#ordinal`, the module can have dots in it but the name can't
+		const size_t separator = entry->forwarder.rfind('.');
+		if (separator == std::string_view::npos || separator == 0 || separator + 1 == entry->forwarder.size()) {
+			result.error = module->path.filename().u8string() + " has a malformed forwarder for " + std::string(symbol);
+			return result;
+		}
+		// points into the mapped file, which stays mapped as long as the resolver does
+		module_name = entry->forwarder.substr(0, separator);
+		symbol = entry->forwarder.substr(separator + 1);
+		referrer = module;
+	}
+
+	result.error = "gave up following the forwarders for " + std::string(symbol);
+	return result;
+}
+
+std::vector<ExportResolver::Result> ExportResolver::resolve_batch(const std::vector<Request>& requests)
+{
+	std::vector<Result> results;
+	results.reserve(requests.size());
+	for (const auto& request : requests)
+		results.push_back(resolve(request.module, request.symbol));
+	return results;
+}
+
+const PEExports* ExportResolver::get_exports(std::string_view module_name, std::string* error)
+{
+	std::string load_error;
+	const Module* module = load_module(module_name, nullptr, load_error);
+	if (error)
+		*error = load_error;
+	return module ? &*module->exports : nullptr;
+}
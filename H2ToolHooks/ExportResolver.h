@@ -0,0 +1,99 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#pragma once
+#include "MappedFile.h"
+#include "PEExports.h"
+#include "PEImage.h"
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	Resolves exported symbols straight from the DLL files, following forwarders into other DLLs, without loading anything.
+	Each DLL is mapped and its export table parsed once, so resolving a whole batch costs about the same as one symbol.
+	The RVA is only an address once it is added to where the module is loaded in the process it's used in.
+*/
+class ExportResolver
+{
+public:
+	struct Result
+	{
+		// the DLL that implements the symbol once every forwarder has been followed
+		std::filesystem::path module;
+		uint32_t rva = 0;
+		// why it couldn't be resolved, empty if it was
+		std::string error;
+
+		bool is_resolved() const {
+			return error.empty();
+		}
+	};
+
+	struct Request
+	{
+		std::string module;
+		std::string symbol;
+	};
+
+	/*
+		DLLs that aren't given as a path, including the ones forwarded to, are looked for in the directory of the DLL
+		that forwards to them and then in `search_paths`, ignoring case and adding .dll if there is no extension
+	*/
+	explicit ExportResolver(std::vector<std::filesystem::path> search_paths = {});
+
+	ExportResolver(const ExportResolver&) = delete;
+	ExportResolver& operator=(const ExportResolver&) = delete;
+
+	/*
+		Resolves `symbol` exported by `module`, `#ordinal` looks it up by ordinal
+	*/
+	Result resolve(std::string_view module, std::string_view symbol);
+
+	/*
+		Resolves every request in order, sharing the DLLs that are mapped between them
+	*/
+	std::vector<Result> resolve_batch(const std::vector<Request>& requests);
+
+	/*
+		The export table of `module`, null if it couldn't be found or read, `error` says why
+	*/
+	const PEExports* get_exports(std::string_view module, std::string* error = nullptr);
+
+	// how many forwarders are followed before giving up, they could go around in a loop
+	static constexpr size_t max_forwarder_depth = 16;
+
+private:
+	struct Module
+	{
+		explicit Module(const std::filesystem::path& path) :
+			path(path),
+			file(path)
+		{}
+
+		std::filesystem::path path;
+		MappedFile file;
+		std::optional<PEImage> image;
+		std::optional<PEExports> exports;
+	};
+
+	/*
+		Finds and maps `name`, `referrer` is the DLL forwarding to it if there is one. Returns null and sets `error` on failure.
+	*/
+	Module* load_module(std::string_view name, const Module* referrer, std::string& error);
+
+	std::optional<std::filesystem::path> find_module_file(std::string_view name, const Module* referrer) const;
+
+	std::vector<std::filesystem::path> search_paths;
+	// keyed by the lowercase path of the file
+	std::map<std::string, std::unique_ptr<Module>> modules;
+	// keyed by the lowercase name asked for and the directory it was looked up from
+	std::map<std::string, Module*> module_names;
+};
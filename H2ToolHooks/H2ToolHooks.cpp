@@ -7,39 +7,49 @@
 
 #include "H2ToolHooks.h"
 #include "PatternScanner.h"
-#include "patches.h"
+#include "Signatures.h"
 #include "Debug.h"
 #include "KeyValueConfig.h"
+#include "ScanCache.h"
+#include "PatchTransaction.h"
 
-static bool disable_assertions(const PatternScanner &scanner)
+// stored next to custom_lightmap_quality.conf
+constexpr static char scan_cache_filename[] = "tool_hooks_scan_cache.conf";
+
+static bool disable_assertions(const PatternScanner &scanner, ScanCache &cache, PatchTransaction &patches)
 {
-	DebugPrintf("Disabling assertions");
+	LOG_INFO("Disabling assertions");
 	/*
 	* Perform signature scanning to find the instructions we need to patch
 	*/
-	std::array<pattern_entry, 7> hs_assert = {
-		PAT_BYTES(2, {0x6A, 0x01}), // push    1 (is fatal)
-		PAT_BYTE(0x68), PAT_INTEGER_RANGE(uint32_t, 2960 - 400, 2960 + 400), // push c_line_number
-		PAT_BYTE(0x68), PAT_ANY(4), // push c_file_name
-		PAT_BYTE(0x68), PAT_STRING_XREF("hs_type_valid(definition->return_type)")
-	};
-
-	DebugPrintf("Scanning for hs assert");
-	const auto hs_match = scanner.find_pattern_in_code(hs_assert);
-
-	
+	using namespace Signatures;
+
+	PatternScanner::StatsLabel hs_assert_label(scanner, "hs_assert");
+	auto hs_matches = cache.lookup("hs_assert", hs_assert);
+	// only set if the assert sites were scanned for in the same pass as hs_assert
+	std::optional<std::vector<PatternScanner::Match>> assert_candidates;
+	if (!hs_matches) {
+		LOG_DEBUG("Scanning for hs assert and assert sites");
+		auto [hs_assert_matches, assert_candidate_matches] = scanner.find_patterns_in_code(
+			PatternScanner::search(hs_assert, 1),
+			PatternScanner::search(assert_candidate_pat)
+		);
+		hs_matches = std::move(hs_assert_matches);
+		assert_candidates = std::move(assert_candidate_matches);
+		cache.store("hs_assert", hs_assert, *hs_matches);
+	}
 
-	if (hs_match) {
-		const uint32_t hs_assert_call_address = hs_match->offset + hs_match->length;
-		DebugPrintf("hs assert offset: %x", hs_assert_call_address);
+	if (!hs_matches->empty()) {
+		const uintptr_t hs_assert_call_address = static_cast<uintptr_t>((*hs_matches)[0].offset + (*hs_matches)[0].length);
+		LOG_DEBUG("hs assert offset: %zx", hs_assert_call_address);
 
 		bool is_exit_patched = false;
 
-		uint32_t display_assert_offset = get_function_address_from_call(hs_assert_call_address);
-		uint32_t system_debugger_present_offset = get_function_address_from_call(hs_assert_call_address + 0x3 + 0x5);
+		uintptr_t display_assert_offset = get_function_address_from_call(hs_assert_call_address);
+		uintptr_t system_debugger_present_offset = get_function_address_from_call(hs_assert_call_address + 0x3 + 0x5);
 
-		DebugPrintf("display_assert offset: %x", display_assert_offset);
-		DebugPrintf("system_debugger_present offset: %x", system_debugger_present_offset);
+		LOG_DEBUG("display_assert offset: %zx", display_assert_offset);
+		LOG_DEBUG("system_debugger_present offset: %zx", system_debugger_present_offset);
 
 		for (auto search_off = hs_assert_call_address + 0x3; search_off < hs_assert_call_address + 0x50; search_off++) {
 			auto data = reinterpret_cast<uint8_t*>(search_off);
@@ -48,8 +58,8 @@ static bool disable_assertions(const PatternScanner &scanner)
 				auto system_exit_offset = get_function_address_from_call(search_off + 2);
 
 				// disable system_exit by replacing it with a no-op
-				DebugPrintf("Patching system_exit @ %x", system_exit_offset);
-				WriteValue<uint8_t>(system_exit_offset, 0xC3);
+				LOG_DEBUG("Patching system_exit @ %zx", system_exit_offset);
+				patches.write_value<uint8_t>(system_exit_offset, 0xC3);
 
 				is_exit_patched = true;
 				break;
@@ -58,31 +68,49 @@ static bool disable_assertions(const PatternScanner &scanner)
 
 		if (!is_exit_patched)
 		{
-			DebugPrintf("Failed to disable system_exit!");
+			LOG_ERROR("Failed to disable system_exit!");
 			return false;
 		}
 
-		std::array<pattern_entry, 10> assert_pat = {
-			PAT_BYTES(2, { 0x6A, 0x01}), //  push 1 (is fatal)
-			PAT_BYTE(0x68), PAT_ANY(4),  //  push c_line
-			PAT_BYTE(0x68), PAT_ANY(4),  //  push c_filename
-			PAT_BYTE(0x68), PAT_ANY(4),  //  push c_assertion_message
-			PAT_CALL(display_assert_offset), // call display_assert
-			PAT_BYTES(3, { 0x83, 0xC4, 0x10}), // add esp, 10h
-			PAT_CALL(system_debugger_present_offset) // call system_debugger_present
+		const auto assert_site = assert_pat(display_assert_offset, system_debugger_present_offset);
+		PatternScanner::StatsLabel assert_sites_label(scanner, "assert_sites");
+		auto disable_fatal = [&patches](const PatternScanner::Match &assert) {
+			patches.write_value<uint8_t>(static_cast<uintptr_t>(assert.offset + 1), 0x00);
 		};
-		auto asserts = scanner.find_pattern_in_code_multiple(assert_pat);
-		DebugPrintf("Found %d asserts", asserts.size());
-		for (auto &assert : asserts) {
-			WriteValue<uint8_t>(assert.offset + 1, 0x00); // disable fatal
+		auto asserts = cache.lookup("assert_sites", assert_site);
+		if (asserts) {
+			for (auto &assert : *asserts)
+				disable_fatal(assert);
 		}
-		DebugPrintf("Patched all asserts found!");
+		else {
+			// queue the patch for each site as soon as it's found, the list is only kept for the cache
+			asserts.emplace();
+			if (assert_candidates) {
+				// keep the sites calling display_assert and system_debugger_present out of the ones found with hs_assert
+				for (auto &candidate : *assert_candidates) {
+					if (is_assert_site(scanner, candidate.offset, display_assert_offset, system_debugger_present_offset)) {
+						disable_fatal(candidate);
+						asserts->push_back(candidate);
+					}
+				}
+			}
+			else {
+				// hs_assert came from the cache, so the sites are looked up from the callers of display_assert
+				for (auto &assert : scanner.find_pattern_matches_in_code(assert_site)) {
+					disable_fatal(assert);
+					asserts->push_back(assert);
+				}
+			}
+			cache.store("assert_sites", assert_site, *asserts);
+		}
+		LOG_INFO("Found %zu asserts", asserts->size());
+		LOG_DEBUG("Queued patches for all asserts found!");
 
 		return true;
 	}
 	else
 	{
-		DebugPrintf("Failed to find hs_assert keystone");
+		LOG_ERROR("Failed to find hs_assert keystone");
 	}
 
 	return false;
@@ -103,29 +131,30 @@ static_assert(sizeof(lightmap_settings) == 32);
 
 constexpr static lightmap_settings base_custom_settings = { "custom", 4, 8, false, 20000000, /*unknown*/ 0, 4.f, false };
 
-static bool patch_lightmap_quality(const PatternScanner &scanner)
+static bool patch_lightmap_quality(const PatternScanner &scanner, ScanCache &cache, PatchTransaction &patches)
 {
-	DebugPrintf("Patching lightmap quality");
-	std::array<pattern_entry, 8> cuban_lightmap_setting = {
-		PAT_STRING_XREF("cuban"),
-		PAT_POD_TYPE(int32_t(1)), // subpixel count
-		PAT_POD_TYPE(int32_t(1)), // monte carlo sample count
-		PAT_POD_TYPE(int32_t(0)), // is_draft
-		PAT_POD_TYPE(int32_t(50000)), // photon count
-		PAT_POD_TYPE(int32_t(0)), // unknown
-		PAT_POD_TYPE(float(1.0f)), // search distance setting
-		PAT_POD_TYPE(int32_t(0)) // is checkboard
-	};
-
-	auto cuban_match = scanner.find_pattern_in_rdata(cuban_lightmap_setting);
+	LOG_INFO("Patching lightmap quality");
+	using Signatures::cuban_lightmap_setting;
+
+	PatternScanner::StatsLabel label(scanner, "cuban_lightmap_setting");
+	std::optional<PatternScanner::Match> cuban_match;
+	auto cached_cuban_matches = cache.lookup("cuban_lightmap_setting", cuban_lightmap_setting);
+	if (cached_cuban_matches) {
+		cuban_match = (*cached_cuban_matches)[0];
+	}
+	else {
+		cuban_match = scanner.find_pattern_in_rdata(cuban_lightmap_setting);
+		if (cuban_match)
+			cache.store("cuban_lightmap_setting", cuban_lightmap_setting, { *cuban_match });
+	}
 
 	if (!cuban_match)
 	{
-		DebugPrintf("Failed to find lightmap quality settings!");
+		LOG_ERROR("Failed to find lightmap quality settings!");
 		return false;
 	}
 
-	lightmap_settings* cuban_quality_setting = reinterpret_cast<lightmap_settings*>(cuban_match->offset);
+	lightmap_settings* cuban_quality_setting = reinterpret_cast<lightmap_settings*>(static_cast<uintptr_t>(cuban_match->offset));
 
 	KeyValueFile config("custom_lightmap_quality.conf");
 
@@ -133,26 +162,58 @@ static bool patch_lightmap_quality(const PatternScanner &scanner)
 
 	quality_settings.photon_count = config.getNumber<int32_t>("photon_count", quality_settings.photon_count);
 	quality_settings.monte_carlo_sample_count = config.getNumber<int32_t>("monte_carlo_sample_count", quality_settings.monte_carlo_sample_count);
+	// writes out the defaults the first time, after that every worker finds them there and leaves the file alone
+	config.Save();
 
 	// patch config in rdata
-	WriteValue(cuban_match->offset, quality_settings);
+	patches.write_value(static_cast<uintptr_t>(cuban_match->offset), quality_settings);
 
 	return true;
 }
 
+PatchTransaction& H2ToolHooks::get_patches()
+{
+	static PatchTransaction patches;
+	return patches;
+}
+
 bool H2ToolHooks::hook(HookFlags flags)
 {
 	PatternScanner scanner;
+	scanner.set_instruction_boundaries_only(flags & HookFlags::InstructionBoundaries);
+	ScanCache cache(scanner, scan_cache_filename);
+	// every patch is applied at the end, so each page is only unprotected once and nothing is applied if a hook fails
+	PatchTransaction& patches = get_patches();
 	bool success = true;
 
 	if (flags & HookFlags::DisableAsserts)
 	{
-		success = disable_assertions(scanner) && success;
+		success = disable_assertions(scanner, cache, patches) && success;
 	}
 	if (flags & HookFlags::PatchLightmapQuality)
 	{
-		success = patch_lightmap_quality(scanner) && success;
+		success = patch_lightmap_quality(scanner, cache, patches) && success;
+	}
+
+	// all or nothing, running half patched is worse than not being patched at all
+	if (!success)
+	{
+		LOG_ERROR("Not applying %zu patches, a hook failed", patches.get_pending_count());
+		patches.discard();
+	}
+	else
+	{
+		LOG_INFO("Applying %zu patches", patches.get_pending_count());
+		// nothing is written if a page can't be made writable. Reading the patches back straight after would only find
+		// what was just written, the journal stays in get_patches() so they are checked at DLL_PROCESS_DETACH instead.
+		if (!patches.commit())
+		{
+			LOG_ERROR("Failed to make the patched pages writable!");
+			success = false;
+		}
 	}
 
+	scanner.print_stats();
+
 	return success;
 }
\ No newline at end of file
@@ -6,6 +6,8 @@
 
 
 #pragma once
+class PatchTransaction;
+
 namespace H2ToolHooks
 {
 	enum HookFlags
@@ -14,6 +16,13 @@ namespace H2ToolHooks
 
 		DisableAsserts = 1 << 0,
 		PatchLightmapQuality = 1 << 1,
+		// only match code signatures at instruction starts
+		InstructionBoundaries = 1 << 2,
 	};
 	bool hook(HookFlags flags);
+
+	/*
+		The patches `hook` applied, kept for as long as the DLL is loaded so they can be checked or rolled back later
+	*/
+	PatchTransaction& get_patches();
 }
\ No newline at end of file
@@ -0,0 +1,199 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#include "InstructionLength.h"
+#include <algorithm>
+
+// what follows an opcode, or what the byte is instead of an opcode
+static constexpr uint8_t NA = 0; // nothing
+static constexpr uint8_t M = 1 << 0; // ModRM, and the SIB and displacement it asks for
+static constexpr uint8_t I8 = 1 << 1; // 8-bit immediate
+static constexpr uint8_t IW = 1 << 2; // 16-bit immediate
+static constexpr uint8_t IZ = 1 << 3; // 16 or 32-bit immediate depending on the operand size
+static constexpr uint8_t MO = 1 << 4; // absolute address, as wide as the address size
+static constexpr uint8_t P = 1 << 5; // legacy prefix
+static constexpr uint8_t N64 = 1 << 6; // not valid in 64-bit code
+static constexpr uint8_t X = 1 << 7; // not valid at all
+
+static constexpr uint8_t one_byte_opcodes[256] = {
+	//0      1      2      3      4      5      6      7      8      9      A      B      C      D      E      F
+	M,     M,     M,     M,     I8,    IZ,    N64,   N64,   M,     M,     M,     M,     I8,    IZ,    N64,   NA,    // 0
+	M,     M,     M,     M,     I8,    IZ,    N64,   N64,   M,     M,     M,     M,     I8,    IZ,    N64,   N64,   // 1
+	M,     M,     M,     M,     I8,    IZ,    P,     N64,   M,     M,     M,     M,     I8,    IZ,    P,     N64,   // 2
+	M,     M,     M,     M,     I8,    IZ,    P,     N64,   M,     M,     M,     M,     I8,    IZ,    P,     N64,   // 3
+	NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    // 4
+	NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    // 5
+	N64,   N64,   M|N64, M,     P,     P,     P,     P,     IZ,    M|IZ,  I8,    M|I8,  NA,    NA,    NA,    NA,    // 6
+	I8,    I8,    I8,    I8,    I8,    I8,    I8,    I8,    I8,    I8,    I8,    I8,    I8,    I8,    I8,    I8,    // 7
+	M|I8,  M|IZ,  M|I8|N64, M|I8, M,   M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     // 8
+	NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    IZ|IW|N64, NA, NA,    NA,    NA,    NA,    // 9
+	MO,    MO,    MO,    MO,    NA,    NA,    NA,    NA,    I8,    IZ,    NA,    NA,    NA,    NA,    NA,    NA,    // A
+	I8,    I8,    I8,    I8,    I8,    I8,    I8,    I8,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    // B
+	M|I8,  M|I8,  IW,    NA,    M|N64, M|N64, M|I8,  M|IZ,  IW|I8, NA,    IW,    NA,    NA,    I8,    N64,   NA,    // C
+	M,     M,     M,     M,     I8|N64, I8|N64, N64, NA,    M,     M,     M,     M,     M,     M,     M,     M,     // D
+	I8,    I8,    I8,    I8,    I8,    I8,    I8,    I8,    IZ,    IZ,    IZ|IW|N64, I8, NA,    NA,    NA,    NA,    // E
+	P,     NA,    P,     P,     NA,    NA,    M,     M,     NA,    NA,    NA,    NA,    NA,    NA,    M,     M,     // F
+};
+
+// after 0F, 0F 38 and 0F 3A are decoded separately
+static constexpr uint8_t two_byte_opcodes[256] = {
+	//0      1      2      3      4      5      6      7      8      9      A      B      C      D      E      F
+	M,     M,     M,     M,     X,     NA,    NA,    NA,    NA,    NA,    X,     NA,    X,     M,     NA,    M|I8,  // 0
+	M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     // 1
+	M,     M,     M,     M,     X,     X,     X,     X,     M,     M,     M,     M,     M,     M,     M,     M,     // 2
+	NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    X,     X,     X,     X,     X,     X,     X,     X,     // 3
+	M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     // 4
+	M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     // 5
+	M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     // 6
+	M|I8,  M|I8,  M|I8,  M|I8,  M,     M,     M,     NA,    M,     M,     X,     X,     M,     M,     M,     M,     // 7
+	IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    IZ,    // 8
+	M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     // 9
+	NA,    NA,    NA,    M,     M|I8,  M,     X,     X,     NA,    NA,    NA,    M,     M|I8,  M,     M,     M,     // A
+	M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M|I8,  M,     M,     M,     M,     M,     // B
+	M,     M,     M|I8,  M,     M|I8,  M|I8,  M|I8,  M,     NA,    NA,    NA,    NA,    NA,    NA,    NA,    NA,    // C
+	M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     // D
+	M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     // E
+	M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     M,     // F
+};
+
+size_t InstructionLength::decode(const uint8_t* code, size_t size, bool is_64bit)
+{
+	const size_t limit = std::min(size, max_length);
+	size_t length = 0;
+
+	bool operand_size_prefix = false;
+	bool address_size_prefix = false;
+	// REX.W makes the operand 64-bit, but only counts if nothing comes between it and the opcode
+	bool rex_w = false;
+	for (; length < limit; length++) {
+		if (one_byte_opcodes[code[length]] & P) {
+			operand_size_prefix |= code[length] == 0x66;
+			address_size_prefix |= code[length] == 0x67;
+			rex_w = false;
+		}
+		else if (is_64bit && (code[length] & 0xF0) == 0x40) {
+			rex_w = (code[length] & 0x08) != 0;
+		}
+		else {
+			break;
+		}
+	}
+
+	if (length >= limit)
+		return 0;
+	uint8_t opcode = code[length++];
+	uint8_t flags;
+	bool is_one_byte = false;
+	// the moves to and from control and debug registers always take a register, whatever the ModRM says
+	bool is_register_only = false;
+	// relative branches ignore the operand size prefix in 64-bit code
+	bool is_branch = false;
+
+	if (opcode == 0x0F) {
+		if (length >= limit)
+			return 0;
+		opcode = code[length++];
+		if (opcode == 0x38 || opcode == 0x3A) {
+			flags = opcode == 0x3A ? M | I8 : M;
+			length++;
+		}
+		else {
+			flags = two_byte_opcodes[opcode];
+			is_branch = (opcode & 0xF0) == 0x80;
+			is_register_only = opcode >= 0x20 && opcode <= 0x23;
+		}
+	}
+	// outside 64-bit code these are LES/LDS unless the next byte couldn't be a memory operand
+	else if ((opcode == 0xC4 || opcode == 0xC5) && length < limit && (is_64bit || (code[length] & 0xC0) == 0xC0)) {
+		// VEX stands in for the 0F escapes and the prefixes, the map it selects decides what follows
+		size_t map = 1;
+		if (opcode == 0xC4) {
+			map = code[length] & 0x1F;
+			length += 2;
+		}
+		else {
+			length += 1;
+		}
+		if (length >= limit)
+			return 0;
+		opcode = code[length++];
+		if (map == 1)
+			flags = two_byte_opcodes[opcode];
+		else if (map == 2)
+			flags = M;
+		else if (map == 3)
+			flags = M | I8;
+		else
+			return 0;
+	}
+	else {
+		flags = one_byte_opcodes[opcode];
+		if (is_64bit && (flags & N64))
+			return 0;
+		is_one_byte = true;
+		is_branch = opcode == 0xE8 || opcode == 0xE9;
+	}
+
+	if (flags & X)
+		return 0;
+
+	if (flags & M) {
+		if (length >= limit)
+			return 0;
+		const uint8_t modrm = code[length++];
+		const uint8_t mod = modrm >> 6;
+		const uint8_t reg = (modrm >> 3) & 7;
+		const uint8_t rm = modrm & 7;
+
+		// only TEST in group 3 has an immediate
+		if (is_one_byte && (opcode == 0xF6 || opcode == 0xF7) && reg < 2)
+			flags |= opcode == 0xF6 ? I8 : IZ;
+
+		if (mod != 3 && !is_register_only) {
+			if (address_size_prefix && !is_64bit) {
+				// 16-bit addressing has no SIB
+				if (mod == 1)
+					length += 1;
+				else if (mod == 2 || (mod == 0 && rm == 6))
+					length += 2;
+			}
+			else {
+				if (rm == 4) {
+					if (length >= limit)
+						return 0;
+					const uint8_t sib = code[length++];
+					if (mod == 0 && (sib & 7) == 5)
+						length += 4;
+				}
+				if (mod == 1)
+					length += 1;
+				else if (mod == 2 || (mod == 0 && rm == 5))
+					length += 4;
+			}
+		}
+	}
+
+	if (flags & I8)
+		length += 1;
+	if (flags & IW)
+		length += 2;
+	if (flags & IZ) {
+		if (is_one_byte && opcode >= 0xB8 && opcode <= 0xBF && rex_w)
+			length += 8; // mov reg, imm64
+		else if (operand_size_prefix && !(is_64bit && (is_branch || rex_w)))
+			length += 2;
+		else
+			length += 4;
+	}
+	if (flags & MO) {
+		if (is_64bit)
+			length += address_size_prefix ? 4 : 8;
+		else
+			length += address_size_prefix ? 2 : 4;
+	}
+
+	return length <= limit ? length : 0;
+}
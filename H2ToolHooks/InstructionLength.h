@@ -0,0 +1,25 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/*
+	Works out how long x86 and x64 instructions are from their prefixes, opcode, ModRM and SIB bytes without decoding what they do.
+	Table driven and doesn't depend on anything windows specific, so it can be run over any byte buffer.
+*/
+class InstructionLength
+{
+public:
+	/*
+		Returns the length of the instruction at `code`, or zero if the bytes aren't a valid instruction or it doesn't fit in `size`
+	*/
+	static size_t decode(const uint8_t* code, size_t size, bool is_64bit);
+
+	// longest encoding the CPU will accept
+	static constexpr size_t max_length = 15;
+};
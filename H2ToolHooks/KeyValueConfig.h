@@ -10,8 +10,16 @@
 #include <fstream>
 #include <iostream>
 #include <filesystem>
-#include <map>
+#include <vector>
+#include <deque>
+#include <algorithm>
 #include <optional>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 
 class KeyValueError : public std::runtime_error
@@ -29,6 +37,11 @@ public:
 	}
 };
 
+/*
+	A `name = value` settings file. The file is read into one buffer and the settings point into it,
+	sorted by name so looking one up is a binary search.
+	Saving keeps the file as it was apart from the values that changed, so comments and ordering survive.
+*/
 class KeyValueFile
 {
 	inline static std::string_view str_trim(std::string_view str, const std::string& trim_char = " ")
@@ -36,8 +49,9 @@ class KeyValueFile
 		if (str.empty())
 			return str;
 		auto start = str.find_first_not_of(trim_char);
+		// still points into `str`, saving uses where values are in the file
 		if (start == std::string::npos)
-			return "";
+			return str.substr(str.size());
 		else
 			return str.substr(start, str.find_last_not_of(trim_char) - start + 1);
 	}
@@ -47,28 +61,20 @@ public:
 		autosave(autosave),
 		settings_filename(path)
 	{
-		std::ifstream file(path);
-
-		while (file.good())
-		{
-			std::string line;
-			std::getline(file, line);
-
-			size_t cut_point = line.find_first_of('=');
-			if (cut_point == std::string::npos)
-				continue;
-
-			std::string_view name_untrimmed = std::string_view(line).substr(0, cut_point);
-			std::string_view value_untrimmed = std::string_view(line).substr(cut_point + 1);
-
-			// remove trailing and leading spaces.
-			std::string setting_name = std::string(str_trim(name_untrimmed));
-			std::string_view setting_value = str_trim(value_untrimmed);
-			if (validate_setting_name(setting_name))
-				key_value_pairs[std::move(setting_name)] = setting_value;
-			else
-				DebugPrintf("Skipping invalid setting name \"%s\" in configuration file \"%s\"", setting_name.c_str(), path.generic_u8string().c_str());
+		// read rather than mapped, saving replaces the file and a mapping would keep it locked
+		std::ifstream file(path, std::ios::binary);
+		if (file) {
+			file.seekg(0, std::ios::end);
+			const std::streamoff size = file.tellg();
+			file.seekg(0, std::ios::beg);
+			if (size > 0) {
+				contents.resize(static_cast<size_t>(size));
+				file.read(contents.data(), size);
+				contents.resize(static_cast<size_t>(file.gcount()));
+			}
 		}
+
+		parse_contents();
 	}
 
 	~KeyValueFile()
@@ -77,72 +83,169 @@ public:
 			Save();
 	}
 
-	void Save(bool force = false)
+	/*
+		Writes the changed settings to a temporary file next to the settings file and renames it over it, so the file is never left half written.
+		Lines for settings that didn't change are copied as they were and new settings go at the end.
+		Nothing is written if every setting still has the value in the file, unless `force` is set. Returns false if the file couldn't be replaced.
+	*/
+	bool Save(bool force = false)
 	{
-		if (!settings_edited || force)
-			return;
-		std::ofstream settings_file(settings_filename);
-		for (auto i : key_value_pairs)
-			settings_file << i.first << " = " << i.second << std::endl;
-		settings_file.close();
+		struct Replacement
+		{
+			size_t offset;
+			size_t size;
+			std::string_view value;
+		};
+		std::vector<Replacement> replacements;
+		std::vector<const Setting*> new_settings;
+		if (settings_edited) {
+			for (const auto& setting : settings) {
+				if (!setting.is_in_file)
+					new_settings.push_back(&setting);
+				else if (setting.value != setting.file_value)
+					replacements.push_back({ static_cast<size_t>(setting.file_value.data() - contents.data()), setting.file_value.size(), setting.value });
+			}
+		}
+		// setting a value back to what it was, or to a default that was already there, doesn't count
+		if (replacements.empty() && new_settings.empty() && !force)
+			return true;
+
+		std::string output;
+		output.reserve(contents.size() + new_settings.size() * 0x40);
+		std::sort(replacements.begin(), replacements.end(), [](const Replacement& a, const Replacement& b) { return a.offset < b.offset; });
+		size_t copied = 0;
+		for (const auto& replacement : replacements) {
+			output.append(contents, copied, replacement.offset - copied);
+			// `name =` with nothing after it
+			if (replacement.offset > 0 && contents[replacement.offset - 1] == '=')
+				output += ' ';
+			output += replacement.value;
+			copied = replacement.offset + replacement.size;
+		}
+		output.append(contents, copied, std::string::npos);
+
+		const char* line_ending = contents.find("\r\n") != std::string::npos ? "\r\n" : "\n";
+		if (!output.empty() && output.back() != '\n' && !new_settings.empty())
+			output += line_ending;
+		for (const Setting* setting : new_settings) {
+			output += setting->name;
+			output += " = ";
+			output += setting->value;
+			output += line_ending;
+		}
+
+		// other processes might be saving the same file at the same time
+#ifdef _WIN32
+		const unsigned long process_id = GetCurrentProcessId();
+#else
+		const unsigned long process_id = static_cast<unsigned long>(getpid());
+#endif
+		std::filesystem::path temporary_filename = settings_filename;
+		temporary_filename += "." + std::to_string(process_id) + ".tmp";
+		{
+			std::ofstream temporary_file(temporary_filename, std::ios::binary | std::ios::trunc);
+			temporary_file.write(output.data(), static_cast<std::streamsize>(output.size()));
+			temporary_file.close();
+			if (temporary_file.fail()) {
+				LOG_ERROR("Failed to write configuration file \"%s\"", temporary_filename.generic_u8string().c_str());
+				std::error_code ignored;
+				std::filesystem::remove(temporary_filename, ignored);
+				return false;
+			}
+		}
+		std::error_code error;
+		std::filesystem::rename(temporary_filename, settings_filename, error);
+		if (error) {
+			LOG_ERROR("Failed to replace configuration file \"%s\": %s", settings_filename.generic_u8string().c_str(), error.message().c_str());
+			std::filesystem::remove(temporary_filename, error);
+			return false;
+		}
+
+		// what was written is what's in the file now
+		contents = std::move(output);
+		settings.clear();
+		edited_strings.clear();
+		settings_edited = false;
+		parse_contents();
+		return true;
 	}
 
-	/* Throws an expection in case of an error */
-	const std::string& getString(const std::string& setting)
+	/* Throws an expection in case of an error, the value is valid until the setting is changed */
+	std::string_view getString(std::string_view setting)
 	{
-		if (validate_setting_name(setting)) {
-			auto ilter = key_value_pairs.find(setting);
-			if (ilter != key_value_pairs.end())
-				return ilter->second;
-			else
-				throw KeyValueError("No such string");
-		} else {
-			throw KeyValueError("Invalid setting name");
-		}
+		std::string_view value;
+		if (!getString(setting, value))
+			throw KeyValueError("No such string");
+		return value;
 	}
 
 	/* Returns success and throws and expection if the name is invalid */
-	bool getString(const std::string& setting, std::string& value)
+	bool getString(std::string_view setting, std::string& value)
 	{
-		if (validate_setting_name(setting)) {
-			auto ilter = key_value_pairs.find(setting);
-			if (ilter != key_value_pairs.end()) {
-				value = ilter->second;
-				return true;
-			}
-			else {
-				return false;
-			}
-		}
-		throw KeyValueError("Invalid setting name");
+		std::string_view found;
+		if (!getString(setting, found))
+			return false;
+		value = found;
+		return true;
+	}
+
+	/* Same as above without copying the value, which is valid until the setting is changed */
+	bool getString(std::string_view setting, std::string_view& value)
+	{
+		if (!validate_setting_name(setting))
+			throw KeyValueError("Invalid setting name");
+		const auto found = find_setting(setting);
+		if (found == settings.end())
+			return false;
+		value = found->value;
+		return true;
 	}
 
 
 	/// string setters
 
 	/* Throws an error if the setting name is invalid */
-	void setString(const std::string& setting, const std::string& value)
+	void setString(std::string_view setting, std::string_view value)
 	{
-		if (validate_setting_name(setting)) {
-			if (key_value_pairs[setting] != value) {
-				key_value_pairs[setting] = value;
-				settings_edited = true;
-			}
-		}
-		else {
+		if (!validate_setting_name(setting))
 			throw KeyValueError("Invalid setting name");
+
+		auto found = find_setting(setting);
+		if (found == settings.end()) {
+			found = settings.insert(std::lower_bound(settings.begin(), settings.end(), setting, [](const Setting& a, std::string_view name) { return a.name < name; }),
+				{ store_string(setting), std::string_view() });
+		}
+		else if (found->value == value) {
+			return;
 		}
+		found->value = store_string(value);
+		found->parsed_as = parsed_type::none;
+		settings_edited = true;
 	}
 
 	/// Util function
 
 	/* Returns if a setting exists */
-	inline bool exists(const std::string& setting)
+	inline bool exists(std::string_view setting)
 	{
 		if (!validate_setting_name(setting))
 			throw std::invalid_argument("Invalid setting name!");
 
-		return key_value_pairs.find(setting) != key_value_pairs.end();
+		return find_setting(setting) != settings.end();
+	}
+
+	size_t get_setting_count() const
+	{
+		return settings.size();
+	}
+
+	/* Drops every setting, the next save writes only the ones set after this */
+	void clear()
+	{
+		contents.clear();
+		edited_strings.clear();
+		settings.clear();
+		settings_edited = true;
 	}
 
 	/* Checks if the string is a valid setting name */
@@ -153,84 +256,84 @@ public:
 
 	/* Throws an error if the setting name is invalid */
 	template <typename NumericType>
-	NumericType getNumber(const std::string& setting, NumericType default_value)
+	NumericType getNumber(std::string_view setting, NumericType default_value)
+	{
+		if (!validate_setting_name(setting))
+			throw KeyValueError("Invalid setting name");
+
+		NumericType value;
+		if (tryGetNumber(setting, value))
+			return value;
+		setNumber(setting, default_value);
+		return default_value;
+	}
+
+	/*
+		Returns false if the setting doesn't exist, isn't a number or doesn't fit in NumericType, never throws.
+		The value is only parsed the first time it's read, until it is changed.
+	*/
+	template <typename NumericType>
+	bool tryGetNumber(std::string_view setting, NumericType& value)
 	{
 		static_assert(std::is_arithmetic<NumericType>::value, "NumericType must be numeric");
+		using ParsedType = std::conditional_t<std::is_floating_point<NumericType>::value, double,
+			std::conditional_t<std::is_signed<NumericType>::value, int64_t, uint64_t>>;
 
-		std::string value;
-		if (!getString(setting, value)) {
-			setNumber(setting, default_value);
-			return default_value;
-		}
-		try {
-			if (std::is_integral<NumericType>::value) {
-				if (std::is_signed<NumericType>::value)
-					return static_cast<NumericType>(std::stoll(value, 0, get_string_base(value)));
-				else
-					return static_cast<NumericType>(std::stoull(value, 0, get_string_base(value)));
-			}
-			else if (std::is_floating_point<NumericType>::value) {
-				return static_cast<NumericType>(std::stold(value));
-			}
-			else {
-				throw std::runtime_error("Settings::getNumber: unknown NumericType");
-			}
-		}
-		catch (std::invalid_argument) {
-			setNumber(setting, default_value);
-			return default_value;
-		}
-		catch (std::out_of_range) {
-			setNumber(setting, default_value);
-			return default_value;
+		if (!validate_setting_name(setting))
+			return false;
+		const auto found = find_setting(setting);
+		ParsedType parsed;
+		if (found == settings.end() || !get_parsed_value(*found, parsed))
+			return false;
+		if constexpr (std::is_integral<NumericType>::value) {
+			if (parsed < std::numeric_limits<NumericType>::min() || parsed > std::numeric_limits<NumericType>::max())
+				return false;
 		}
+		value = static_cast<NumericType>(parsed);
+		return true;
 	}
 
 	/* Throws an error if the setting name is invalid */
 	template <typename NumericType>
-	inline void setNumber(const std::string& setting, NumericType value)
+	inline void setNumber(std::string_view setting, NumericType value)
 	{
 		static_assert(std::is_arithmetic<NumericType>::value, "NumericType must be numeric");
 		setString(setting, std::to_string(value));
 	}
 
 	/* Throws an error if the setting name is invalid */
-	bool getBoolean(const std::string& setting, bool default_value = false)
+	bool getBoolean(std::string_view setting, bool default_value = false)
 	{
-		std::string value;
-		if (!getString(setting, value) || value.empty()) {
-			setBoolean(setting, default_value);
-			return default_value;
-		}
-		try {
-			return stol(value);
-		}
-		catch (std::invalid_argument) {
-		}
-		catch (std::out_of_range) {
-		}
-		if (case_insensitive_equal(value, "true") || case_insensitive_equal(value, "on")) {
-			return true;
-		}
-		else if (case_insensitive_equal(value, "false") || case_insensitive_equal(value, "off")) {
+		if (!validate_setting_name(setting))
+			throw KeyValueError("Invalid setting name");
+
+		bool value;
+		if (tryGetBoolean(setting, value))
+			return value;
+		setBoolean(setting, default_value);
+		return default_value;
+	}
+
+	/* A number (non-zero is true) or true/on/false/off, returns false if the setting doesn't exist or is neither, never throws */
+	bool tryGetBoolean(std::string_view setting, bool& value)
+	{
+		if (!validate_setting_name(setting))
 			return false;
-		}
-		else {
-			setBoolean(setting, default_value);
-			return default_value;
-		}
+		const auto found = find_setting(setting);
+		return found != settings.end() && get_parsed_value(*found, value);
 	}
+
 	/* Throws an error if the setting name is invalid */
-	void setBoolean(const std::string& setting, bool value)
+	void setBoolean(std::string_view setting, bool value)
 	{
 		setString(setting, value ? "true" : "false");
 	}
 
 private:
 
-	bool case_insensitive_equal(std::string_view a, std::string_view b)
+	static bool case_insensitive_equal(std::string_view a, std::string_view b)
 	{
-		return _strcmpi(a.data(), b.data()) == 0;
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char a, char b) { return tolower(a) == tolower(b); });
 	}
 
 	enum radix
@@ -241,7 +344,7 @@ private:
 	};
 
 
-	int get_string_base(std::string_view value)
+	static int get_string_base(std::string_view value)
 	{
 		auto first_not_whitespace = value.find_first_not_of(" ");
 
@@ -253,7 +356,7 @@ private:
 
 		if (!number_str.empty() && number_str[0] == '0')
 		{
-			if (value.size() >= 2 && (number_str[1] == 'x' || number_str[1] == 'X'))
+			if (number_str.size() >= 2 && (number_str[1] == 'x' || number_str[1] == 'X'))
 				return hexadecimal;
 			return octal;
 		}
@@ -267,8 +370,143 @@ private:
 			&& std::find_if(setting.begin(), setting.end(), [](char c) {return !isalnum(c) && c != '_' && c != '-';  }) == setting.end();
 	}
 
+	enum class parsed_type : uint8_t
+	{
+		none,
+		signed_integer,
+		unsigned_integer,
+		floating_point,
+		boolean
+	};
+
+	struct Setting
+	{
+		std::string_view name;
+		std::string_view value;
+		// the value in `contents`, saving only rewrites it if it's different
+		std::string_view file_value;
+		bool is_in_file = false;
+		// the last typed read of the value, kept so reading it again as the same type doesn't parse it again
+		parsed_type parsed_as = parsed_type::none;
+		bool is_parsed_valid = false;
+		uint64_t parsed = 0;
+	};
+
+	/* ParsedType is int64_t, uint64_t, double or bool */
+	template <typename ParsedType>
+	static bool get_parsed_value(Setting& setting, ParsedType& value)
+	{
+		constexpr parsed_type type = std::is_same<ParsedType, bool>::value ? parsed_type::boolean
+			: std::is_floating_point<ParsedType>::value ? parsed_type::floating_point
+			: std::is_signed<ParsedType>::value ? parsed_type::signed_integer
+			: parsed_type::unsigned_integer;
+		static_assert(sizeof(ParsedType) <= sizeof(Setting::parsed));
+
+		if (setting.parsed_as != type) {
+			ParsedType parsed{};
+			setting.is_parsed_valid = parse_value(setting.value, parsed);
+			setting.parsed_as = type;
+			memcpy(&setting.parsed, &parsed, sizeof(parsed));
+		}
+		memcpy(&value, &setting.parsed, sizeof(value));
+		return setting.is_parsed_valid;
+	}
+
+	/*
+		Parses the number at the start of the value the way std::stoll and std::stold did, ignoring anything after it,
+		with the base from get_string_base for integers
+	*/
+	template <typename ParsedType>
+	static bool parse_value(std::string_view value, ParsedType& parsed)
+	{
+		// std::from_chars doesn't skip whitespace, plus signs or the hex prefix itself
+		const size_t start = value.find_first_not_of(" \t");
+		if (start == std::string_view::npos)
+			return false;
+		value.remove_prefix(start);
+		if (value[0] == '+')
+			value.remove_prefix(1);
+
+		std::from_chars_result result;
+		if constexpr (std::is_integral<ParsedType>::value) {
+			const int base = get_string_base(value);
+			if (base == hexadecimal)
+				value.remove_prefix(2);
+			result = std::from_chars(value.data(), value.data() + value.size(), parsed, base);
+		}
+		else {
+			result = std::from_chars(value.data(), value.data() + value.size(), parsed);
+		}
+		return result.ec == std::errc();
+	}
+
+	static bool parse_value(std::string_view value, bool& parsed)
+	{
+		int64_t number;
+		if (parse_value(value, number)) {
+			parsed = number != 0;
+			return true;
+		}
+		if (case_insensitive_equal(value, "true") || case_insensitive_equal(value, "on")) {
+			parsed = true;
+			return true;
+		}
+		if (case_insensitive_equal(value, "false") || case_insensitive_equal(value, "off")) {
+			parsed = false;
+			return true;
+		}
+		return false;
+	}
+
+	std::vector<Setting>::iterator find_setting(std::string_view name)
+	{
+		auto found = std::lower_bound(settings.begin(), settings.end(), name, [](const Setting& a, std::string_view name) { return a.name < name; });
+		return found != settings.end() && found->name == name ? found : settings.end();
+	}
+
+	/* Fills in the settings from `contents` */
+	void parse_contents()
+	{
+		std::string_view remaining = contents;
+		while (!remaining.empty())
+		{
+			const size_t line_end = remaining.find('\n');
+			std::string_view line = remaining.substr(0, line_end);
+			remaining = line_end == std::string_view::npos ? std::string_view() : remaining.substr(line_end + 1);
+			if (!line.empty() && line.back() == '\r')
+				line.remove_suffix(1);
+
+			size_t cut_point = line.find_first_of('=');
+			if (cut_point == std::string::npos)
+				continue;
+
+			// remove trailing and leading spaces.
+			std::string_view setting_name = str_trim(line.substr(0, cut_point));
+			std::string_view setting_value = str_trim(line.substr(cut_point + 1));
+			if (validate_setting_name(setting_name))
+				settings.push_back({ setting_name, setting_value, setting_value, true });
+			else
+				LOG_WARNING("Skipping invalid setting name \"%s\" in configuration file \"%s\"", std::string(setting_name).c_str(), settings_filename.generic_u8string().c_str());
+		}
+
+		// a name that is set more than once keeps the last value
+		std::stable_sort(settings.begin(), settings.end(), [](const Setting& a, const Setting& b) { return a.name < b.name; });
+		auto last = std::unique(settings.rbegin(), settings.rend(), [](const Setting& a, const Setting& b) { return a.name == b.name; });
+		settings.erase(settings.begin(), last.base());
+	}
+
+	/* Keeps a copy of a string set after the file was read, the deque never moves them */
+	std::string_view store_string(std::string_view string)
+	{
+		return edited_strings.emplace_back(string);
+	}
+
 	std::filesystem::path settings_filename;
-	std::map<std::string, std::string> key_value_pairs;
+	// the whole file, what the settings read from it point into
+	std::string contents;
+	std::deque<std::string> edited_strings;
+	// sorted by name
+	std::vector<Setting> settings;
 	bool settings_edited = false;
 	bool autosave = false;
 };
\ No newline at end of file
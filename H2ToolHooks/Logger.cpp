@@ -0,0 +1,220 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#include "Logger.h"
+#include "platform.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+Logger::Logger(Sink sink, void* context, size_t capacity, FullPolicy full_policy) :
+	sink(sink),
+	context(context),
+	full_policy(full_policy)
+{
+	size_t record_count = 2;
+	while (record_count < capacity)
+		record_count *= 2;
+	records = std::make_unique<Record[]>(record_count);
+	mask = record_count - 1;
+	// a record is free for the producer at position `i` while its sequence is `i`
+	for (size_t i = 0; i < record_count; i++)
+		records[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+Logger::~Logger()
+{
+	is_stopping.store(true, std::memory_order_relaxed);
+	if (thread.joinable())
+		thread.join();
+	flush();
+}
+
+void Logger::start()
+{
+	if (!thread.joinable())
+		thread = std::thread(&Logger::run, this);
+}
+
+Logger::Record* Logger::claim()
+{
+	std::chrono::steady_clock::time_point wait_deadline;
+	bool is_waiting = false;
+	size_t position = enqueue_position.load(std::memory_order_relaxed);
+	for (;;) {
+		Record& record = records[position & mask];
+		const size_t sequence = record.sequence.load(std::memory_order_acquire);
+		const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+		if (difference == 0) {
+			if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				return &record;
+		}
+		else if (difference < 0) {
+			// the drain hasn't caught up with the record from the last time around
+			if (full_policy == FullPolicy::Wait) {
+				const auto now = std::chrono::steady_clock::now();
+				if (!is_waiting) {
+					wait_deadline = now + std::chrono::milliseconds(full_wait_timeout_ms);
+					is_waiting = true;
+				}
+				if (now < wait_deadline) {
+					// write the queue out here if nothing else is, this is also how messages logged in DllMain get out
+					// before the drain thread can start
+					size_t written_count;
+					if (!drain(written_count))
+						std::this_thread::yield();
+					position = enqueue_position.load(std::memory_order_relaxed);
+					continue;
+				}
+			}
+			dropped_count.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		else {
+			position = enqueue_position.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+void Logger::publish(Record* record)
+{
+	const size_t position = record->sequence.load(std::memory_order_relaxed);
+	record->sequence.store(position + 1, std::memory_order_release);
+}
+
+void Logger::write(LogLevel level, const char* format, ...)
+{
+	Record* record = claim();
+	if (!record)
+		return;
+	record->level = level;
+	record->format = format;
+	record->formatter = nullptr;
+	record->long_message = nullptr;
+
+	va_list arguments, long_arguments;
+	va_start(arguments, format);
+	va_copy(long_arguments, arguments);
+	const int length = vsnprintf(record->data, sizeof(record->data), format, arguments);
+	if (length >= static_cast<int>(sizeof(record->data))) {
+		record->long_message = static_cast<char*>(malloc(static_cast<size_t>(length) + 1));
+		if (record->long_message)
+			vsnprintf(record->long_message, static_cast<size_t>(length) + 1, format, long_arguments);
+		else
+			memcpy(record->data + sizeof(record->data) - 4, "...", 4);
+	}
+	va_end(long_arguments);
+	va_end(arguments);
+	publish(record);
+}
+
+int Logger::format_message(char* message, size_t size, const char* format, ...)
+{
+	va_list arguments;
+	va_start(arguments, format);
+	const int length = vsnprintf(message, size, format, arguments);
+	va_end(arguments);
+	return length;
+}
+
+bool Logger::drain(size_t& written_count)
+{
+	written_count = 0;
+	if (is_draining.test_and_set(std::memory_order_acquire))
+		return false;
+
+	for (;;) {
+		Record& record = records[dequeue_position & mask];
+		if (record.sequence.load(std::memory_order_acquire) != dequeue_position + 1)
+			break;
+
+		if (record.long_message) {
+			sink(record.level, record.long_message, context);
+			free(record.long_message);
+			record.long_message = nullptr;
+		}
+		else if (record.formatter) {
+			char message[0x1000];
+			const int length = record.formatter(record, message, sizeof(message));
+			if (length >= static_cast<int>(sizeof(message))) {
+				std::vector<char> long_message(static_cast<size_t>(length) + 1);
+				record.formatter(record, long_message.data(), long_message.size());
+				sink(record.level, long_message.data(), context);
+			}
+			else {
+				sink(record.level, message, context);
+			}
+		}
+		else {
+			sink(record.level, record.data, context);
+		}
+		// free again once the producers have gone all the way around
+		record.sequence.store(dequeue_position + mask + 1, std::memory_order_release);
+		dequeue_position++;
+		written_count++;
+	}
+
+	const size_t dropped = dropped_count.load(std::memory_order_relaxed);
+	if (dropped != reported_dropped_count) {
+		char message[0x80];
+		snprintf(message, sizeof(message), "%zu log messages were dropped, the log buffer was full", dropped - reported_dropped_count);
+		sink(LogLevel::Warning, message, context);
+		reported_dropped_count = dropped;
+	}
+
+	is_draining.clear(std::memory_order_release);
+	return true;
+}
+
+void Logger::flush(unsigned timeout_ms)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	size_t written_count;
+	while (!drain(written_count) && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::yield();
+}
+
+void Logger::run()
+{
+	// back off while there's nothing to write so an idle logger doesn't keep a core busy
+	unsigned wait_ms = 0;
+	while (!is_stopping.load(std::memory_order_relaxed)) {
+		size_t written_count;
+		drain(written_count);
+		if (written_count != 0)
+			wait_ms = 0;
+		else if (wait_ms < 16)
+			wait_ms = wait_ms ? wait_ms * 2 : 1;
+		std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+	}
+}
+
+static void write_to_console(LogLevel, const char* message, void*)
+{
+	fputs(message, stdout);
+	fputc('\n', stdout);
+	fflush(stdout);
+#ifdef _WIN32
+	OutputDebugStringA(message);
+	OutputDebugStringA("\n");
+#endif
+}
+
+Logger& Logger::global()
+{
+	// never destroyed, stopping the thread at DLL_PROCESS_DETACH would deadlock on the loader lock.
+	// The records are only 128KiB and go with the process, the atexit flush writes out whatever is left.
+	static Logger& logger = []() -> Logger& {
+		// the hooks run in DllMain before the drain thread can start, so a full buffer is written out by whoever is logging
+		Logger* logger = new Logger(write_to_console, nullptr, 0x100, FullPolicy::Wait);
+		logger->start();
+		std::atexit([]() { global().flush(); });
+		return *logger;
+	}();
+	return logger;
+}
@@ -0,0 +1,219 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+enum class LogLevel : uint8_t
+{
+	Debug,
+	Info,
+	Warning,
+	Error
+};
+
+/*
+	Queues log messages in a fixed size ring buffer and writes them out on a background thread,
+	so logging never waits on the console. Any number of threads can log at once without taking a lock.
+	When the buffer is full a message is either dropped and counted, or with FullPolicy::Wait the thread logging it
+	writes out the queue itself until there's room. Messages too long for a record are formatted onto the heap.
+
+	Messages are either formatted by the thread logging them (`write`) or, with `write_deferred`, stored as the
+	format string and a copy of the arguments and only formatted when they are written out. The format string has to
+	outlive the logger, which a string literal does, and string arguments are copied into the record.
+*/
+class Logger
+{
+public:
+	/*
+		Gets every message once it is taken off the queue, on whichever thread is draining it
+	*/
+	using Sink = void (*)(LogLevel level, const char* message, void* context);
+
+	enum class FullPolicy : uint8_t
+	{
+		Drop,
+		Wait
+	};
+
+	/*
+		`capacity` is rounded up to a power of two. The drain thread isn't started until `start` is called.
+	*/
+	explicit Logger(Sink sink, void* context = nullptr, size_t capacity = 0x400, FullPolicy full_policy = FullPolicy::Drop);
+
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
+
+	/*
+		Stops the drain thread and writes out whatever is still queued. Must not run under the loader lock,
+		global() is never destroyed for that reason.
+	*/
+	~Logger();
+
+	void write(LogLevel level, const char* format, ...);
+
+	template <typename... Args>
+	void write_deferred(LogLevel level, const char* format, Args... args);
+
+	/*
+		Writes out the queued messages on the calling thread, gives up if the queue is being drained somewhere else
+		for longer than `timeout_ms` (the drain thread might have been killed while it was draining)
+	*/
+	void flush(unsigned timeout_ms = 100);
+
+	/*
+		Starts the background thread, safe to call from DllMain as it doesn't wait for the thread
+	*/
+	void start();
+
+	size_t get_dropped_count() const {
+		return dropped_count.load(std::memory_order_relaxed);
+	}
+
+	/*
+		The console (and the debugger on windows) logger used by the LOG_ macros, started the first time it's used
+		and flushed at exit
+	*/
+	static Logger& global();
+
+	// space for the formatted message or the copied arguments in every record
+	static constexpr size_t record_data_size = 0x200 - 0x28;
+
+	// how long a waiting producer keeps trying before it drops the message, the drain might have been killed part way through
+	static constexpr unsigned full_wait_timeout_ms = 100;
+
+private:
+	struct Record;
+	// returns the length of the whole message like snprintf, even if it didn't fit
+	using Formatter = int (*)(const Record& record, char* message, size_t size);
+
+	struct Record
+	{
+		std::atomic<size_t> sequence;
+		LogLevel level;
+		// null if `data` is the formatted message
+		Formatter formatter;
+		const char* format;
+		// the formatted message if it didn't fit in `data`, freed once it's written out
+		char* long_message;
+		char data[record_data_size];
+	};
+
+	/*
+		Claims the next record for a message. If the buffer is full it returns null and counts the message as dropped,
+		after waiting for a record to be freed first with FullPolicy::Wait.
+	*/
+	Record* claim();
+
+	void publish(Record* record);
+
+	/*
+		Takes messages off the queue until it is empty, returns false without doing anything if it is already being drained
+	*/
+	bool drain(size_t& written_count);
+
+	void run();
+
+	/*
+		How arguments are copied into a deferred record, strings are copied in full and everything else byte for byte
+	*/
+	template <typename T>
+	struct Argument
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Deferred log arguments must be trivially copyable");
+
+		static size_t size(const T&) {
+			return sizeof(T);
+		}
+		static void pack(const T& value, char*& out) {
+			memcpy(out, &value, sizeof(T));
+			out += sizeof(T);
+		}
+		static T unpack(const char*& in) {
+			T value;
+			memcpy(&value, in, sizeof(T));
+			in += sizeof(T);
+			return value;
+		}
+	};
+
+	template <typename... Args>
+	static int format_deferred(const Record& record, char* message, size_t size);
+
+	static int format_message(char* message, size_t size, const char* format, ...);
+
+	Sink sink;
+	void* context;
+	FullPolicy full_policy;
+	std::unique_ptr<Record[]> records;
+	size_t mask;
+	alignas(64) std::atomic<size_t> enqueue_position{ 0 };
+	alignas(64) size_t dequeue_position = 0;
+	std::atomic_flag is_draining = ATOMIC_FLAG_INIT;
+	std::atomic<size_t> dropped_count{ 0 };
+	size_t reported_dropped_count = 0;
+	std::atomic<bool> is_stopping{ false };
+	std::thread thread;
+};
+
+template <>
+struct Logger::Argument<const char*>
+{
+	static size_t size(const char* value) {
+		return strlen(value ? value : "(null)") + 1;
+	}
+	static void pack(const char* value, char*& out) {
+		const size_t length = size(value);
+		memcpy(out, value ? value : "(null)", length);
+		out += length;
+	}
+	static const char* unpack(const char*& in) {
+		const char* value = in;
+		in += strlen(in) + 1;
+		return value;
+	}
+};
+
+template <>
+struct Logger::Argument<char*> : Logger::Argument<const char*> {};
+
+template <typename... Args>
+int Logger::format_deferred(const Record& record, char* message, size_t size)
+{
+	[[maybe_unused]] const char* in = record.data;
+	// braced initialisation unpacks the arguments in order
+	const std::tuple<decltype(Argument<Args>::unpack(in))...> values{ Argument<Args>::unpack(in)... };
+	return std::apply([&](const auto&... value) { return format_message(message, size, record.format, value...); }, values);
+}
+
+template <typename... Args>
+void Logger::write_deferred(LogLevel level, const char* format, Args... args)
+{
+	const size_t size = (size_t{ 0 } + ... + Argument<Args>::size(args));
+	// too big to copy, format it now instead
+	if (size > record_data_size) {
+		write(level, format, args...);
+		return;
+	}
+
+	Record* record = claim();
+	if (!record)
+		return;
+	record->level = level;
+	record->format = format;
+	record->formatter = &format_deferred<Args...>;
+	record->long_message = nullptr;
+	[[maybe_unused]] char* out = record->data;
+	(Argument<Args>::pack(args, out), ...);
+	publish(record);
+}
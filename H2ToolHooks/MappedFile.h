@@ -0,0 +1,43 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+
+/*
+	Read-only memory mapping of a whole file
+*/
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::filesystem::path& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool is_open() const {
+		return mapping_data != nullptr;
+	}
+
+	const uint8_t* data() const {
+		return mapping_data;
+	}
+
+	size_t size() const {
+		return mapping_size;
+	}
+
+private:
+	const uint8_t* mapping_data = nullptr;
+	size_t mapping_size = 0;
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+};
@@ -0,0 +1,125 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#include "PEExports.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+template <typename T>
+static T read_value(const uint8_t* data, size_t index)
+{
+	T value;
+	memcpy(&value, data + index * sizeof(T), sizeof(T));
+	return value;
+}
+
+std::optional<PEExports> PEExports::parse(const PEImage& image)
+{
+	PEExports exports;
+	const PEImage::DataDirectory directory = image.get_directory(PEImage::directory_export);
+	if (directory.virtual_address == 0 || directory.size == 0)
+		return exports;
+
+	// IMAGE_EXPORT_DIRECTORY
+	const uint8_t* header = image.rva_to_pointer(directory.virtual_address, 40);
+	if (!header)
+		return std::optional<PEExports>{};
+	const uint32_t name_rva = read_value<uint32_t>(header + 12, 0);
+	const uint32_t function_count = read_value<uint32_t>(header + 20, 0);
+	const uint32_t name_count = read_value<uint32_t>(header + 24, 0);
+	const uint32_t functions_rva = read_value<uint32_t>(header + 28, 0);
+	const uint32_t names_rva = read_value<uint32_t>(header + 32, 0);
+	const uint32_t name_ordinals_rva = read_value<uint32_t>(header + 36, 0);
+	exports.ordinal_base = read_value<uint32_t>(header + 16, 0);
+	exports.module_name = image.rva_to_string(name_rva);
+
+	// ordinals are 16-bit, so is the index into the functions for every name
+	if (function_count > 0x10000 || name_count > function_count || exports.ordinal_base + uint64_t(function_count) > 0x10000)
+		return std::optional<PEExports>{};
+
+	const uint8_t* functions = function_count ? image.rva_to_pointer(functions_rva, function_count * 4) : nullptr;
+	const uint8_t* names = name_count ? image.rva_to_pointer(names_rva, name_count * 4) : nullptr;
+	const uint8_t* name_ordinals = name_count ? image.rva_to_pointer(name_ordinals_rva, name_count * 2) : nullptr;
+	if ((function_count && !functions) || (name_count && (!names || !name_ordinals)))
+		return std::optional<PEExports>{};
+
+	exports.ordinals.assign(function_count, -1);
+	exports.exports.reserve(function_count);
+	for (uint32_t i = 0; i < function_count; i++) {
+		const uint32_t rva = read_value<uint32_t>(functions, i);
+		if (rva == 0)
+			continue;
+
+		Export entry = { static_cast<uint16_t>(exports.ordinal_base + i), rva, std::string_view{}, std::string_view{} };
+		// an address inside the export directory is the name of the export it forwards to
+		if (rva >= directory.virtual_address && rva - directory.virtual_address < directory.size) {
+			entry.forwarder = image.rva_to_string(rva);
+			if (entry.forwarder.empty())
+				return std::optional<PEExports>{};
+			entry.rva = 0;
+		}
+		exports.ordinals[i] = static_cast<int32_t>(exports.exports.size());
+		exports.exports.push_back(entry);
+	}
+
+	exports.names.reserve(name_count);
+	for (uint32_t i = 0; i < name_count; i++) {
+		const uint16_t function_index = read_value<uint16_t>(name_ordinals, i);
+		const std::string_view name = image.rva_to_string(read_value<uint32_t>(names, i));
+		if (function_index >= function_count || exports.ordinals[function_index] < 0 || name.empty())
+			return std::optional<PEExports>{};
+
+		const uint32_t export_index = static_cast<uint32_t>(exports.ordinals[function_index]);
+		// a function can be exported under more than one name, get_exports only gives the first
+		if (exports.exports[export_index].name.empty())
+			exports.exports[export_index].name = name;
+		exports.names.push_back({ name, export_index });
+	}
+
+	// the linker sorts the names so the loader can binary search them, but that isn't checked anywhere
+	const auto name_less = [](const Name& left, const Name& right) {
+		return left.name < right.name;
+	};
+	if (!std::is_sorted(exports.names.begin(), exports.names.end(), name_less))
+		std::sort(exports.names.begin(), exports.names.end(), name_less);
+
+	return exports;
+}
+
+const PEExports::Export* PEExports::find(std::string_view name) const
+{
+	const auto found = std::lower_bound(names.begin(), names.end(), name, [](const Name& entry, std::string_view value) {
+		return entry.name < value;
+	});
+	if (found == names.end() || found->name != name)
+		return nullptr;
+	return &exports[found->export_index];
+}
+
+const PEExports::Export* PEExports::find(uint16_t ordinal) const
+{
+	if (ordinal < ordinal_base || ordinal - ordinal_base >= ordinals.size() || ordinals[ordinal - ordinal_base] < 0)
+		return nullptr;
+	return &exports[ordinals[ordinal - ordinal_base]];
+}
+
+const PEExports::Export* PEExports::find_symbol(std::string_view symbol) const
+{
+	uint16_t ordinal;
+	if (parse_ordinal(symbol, ordinal))
+		return find(ordinal);
+	return find(symbol);
+}
+
+bool PEExports::parse_ordinal(std::string_view symbol, uint16_t& ordinal)
+{
+	if (symbol.size() < 2 || symbol[0] != '#')
+		return false;
+	const char* end = symbol.data() + symbol.size();
+	const auto result = std::from_chars(symbol.data() + 1, end, ordinal);
+	return result.ec == std::errc{} && result.ptr == end;
+}
@@ -0,0 +1,77 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#pragma once
+#include "PEImage.h"
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/*
+	The export directory of a PE image, read from the image the same way on any platform.
+	Names and forwarders point into the image data, so it has to stay mapped as long as this is used.
+*/
+class PEExports
+{
+public:
+	struct Export
+	{
+		uint16_t ordinal;
+		// zero for forwarded exports
+		uint32_t rva;
+		// empty if it is only exported by ordinal
+		std::string_view name;
+		// `MODULE.Name` or `MODULE.#ordinal` if the export is implemented by another DLL, empty otherwise
+		std::string_view forwarder;
+	};
+
+	/*
+		Returns an empty table if the image has no export directory, nothing if the directory is malformed
+	*/
+	static std::optional<PEExports> parse(const PEImage& image);
+
+	/*
+		Binary searches the name table, which the linker sorts
+	*/
+	const Export* find(std::string_view name) const;
+
+	const Export* find(uint16_t ordinal) const;
+
+	/*
+		Looks up `#ordinal` by ordinal and anything else by name
+	*/
+	const Export* find_symbol(std::string_view symbol) const;
+
+	/*
+		Every exported function by ordinal, without the unused ordinals
+	*/
+	const std::vector<Export>& get_exports() const {
+		return exports;
+	}
+
+	// the name the DLL was linked as
+	std::string_view module_name;
+	uint32_t ordinal_base = 0;
+
+	/*
+		Parses `#ordinal`, returns false if `symbol` isn't one
+	*/
+	static bool parse_ordinal(std::string_view symbol, uint16_t& ordinal);
+
+private:
+	struct Name
+	{
+		std::string_view name;
+		uint32_t export_index;
+	};
+
+	std::vector<Export> exports;
+	// sorted by name
+	std::vector<Name> names;
+	// index into `exports` for every ordinal from `ordinal_base`, -1 where unused
+	std::vector<int32_t> ordinals;
+};
@@ -0,0 +1,210 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#include "PEImage.h"
+#include <algorithm>
+#include <cstring>
+
+template <typename T>
+static bool read_value(const uint8_t* data, size_t size, size_t offset, T& value)
+{
+	if (offset > size || size - offset < sizeof(T))
+		return false;
+	memcpy(&value, data + offset, sizeof(T));
+	return true;
+}
+
+std::optional<PEImage> PEImage::parse(const uint8_t* data, size_t size, bool is_loaded)
+{
+	PEImage image = {};
+	image.data = data;
+	image.size = size;
+	image.is_loaded = is_loaded;
+
+	uint16_t dos_magic;
+	uint32_t nt_offset;
+	if (!read_value(data, size, 0, dos_magic) || dos_magic != 0x5A4D) // MZ
+		return std::optional<PEImage>{};
+	if (!read_value(data, size, 0x3C, nt_offset))
+		return std::optional<PEImage>{};
+
+	uint32_t nt_signature;
+	if (!read_value(data, size, nt_offset, nt_signature) || nt_signature != 0x4550) // PE\0\0
+		return std::optional<PEImage>{};
+
+	const size_t file_header = size_t(nt_offset) + 4;
+	uint16_t section_count;
+	uint16_t optional_header_size;
+	if (!read_value(data, size, file_header + 2, section_count)
+		|| !read_value(data, size, file_header + 4, image.timestamp)
+		|| !read_value(data, size, file_header + 16, optional_header_size))
+		return std::optional<PEImage>{};
+
+	const size_t optional_header = file_header + 20;
+	uint16_t optional_magic;
+	if (!read_value(data, size, optional_header, optional_magic))
+		return std::optional<PEImage>{};
+
+	size_t directory_count_offset;
+	if (optional_magic == 0x10B) {
+		uint32_t image_base;
+		if (!read_value(data, size, optional_header + 28, image_base))
+			return std::optional<PEImage>{};
+		image.image_base = image_base;
+		image.is_64bit = false;
+		directory_count_offset = optional_header + 92;
+	}
+	else if (optional_magic == 0x20B) {
+		if (!read_value(data, size, optional_header + 24, image.image_base))
+			return std::optional<PEImage>{};
+		image.is_64bit = true;
+		directory_count_offset = optional_header + 108;
+	}
+	else {
+		return std::optional<PEImage>{};
+	}
+
+	uint32_t directory_count;
+	if (!read_value(data, size, optional_header + 32, image.section_alignment)
+		|| !read_value(data, size, optional_header + 56, image.image_size)
+		|| !read_value(data, size, optional_header + 64, image.checksum)
+		|| !read_value(data, size, directory_count_offset, directory_count))
+		return std::optional<PEImage>{};
+
+	for (uint32_t i = 0; i < std::min<uint32_t>(directory_count, 16); i++) {
+		DataDirectory directory;
+		if (!read_value(data, size, directory_count_offset + 4 + i * sizeof(DataDirectory), directory))
+			return std::optional<PEImage>{};
+		image.directories.push_back(directory);
+	}
+
+	const size_t section_headers = optional_header + optional_header_size;
+	for (uint16_t i = 0; i < section_count; i++) {
+		const size_t header = section_headers + i * 40;
+		Section section = {};
+		if (header > size || size - header < 40)
+			return std::optional<PEImage>{};
+		memcpy(section.name, data + header, 8);
+		read_value(data, size, header + 8, section.virtual_size);
+		read_value(data, size, header + 12, section.virtual_address);
+		read_value(data, size, header + 16, section.raw_size);
+		read_value(data, size, header + 20, section.raw_offset);
+		read_value(data, size, header + 36, section.characteristics);
+		image.sections.push_back(section);
+	}
+
+	return image;
+}
+
+const uint8_t* PEImage::section_data(const Section& section) const
+{
+	return data + (is_loaded ? section.virtual_address : section.raw_offset);
+}
+
+uint32_t PEImage::section_data_size(const Section& section) const
+{
+	const size_t start = is_loaded ? section.virtual_address : section.raw_offset;
+	if (start >= size)
+		return 0;
+
+	// a virtual size of zero means the raw size is used
+	size_t section_size = section.virtual_size ? section.virtual_size : section.raw_size;
+	if (!is_loaded)
+		section_size = std::min<size_t>(section_size, section.raw_size);
+	return static_cast<uint32_t>(std::min(section_size, size - start));
+}
+
+const uint8_t* PEImage::rva_to_pointer(uint32_t rva, uint32_t length) const
+{
+	if (is_loaded)
+		return rva < size && size - rva >= length ? data + rva : nullptr;
+
+	for (const auto& section : sections) {
+		if (rva < section.virtual_address)
+			continue;
+		const uint32_t offset = rva - section.virtual_address;
+		if (offset >= section_data_size(section) || section_data_size(section) - offset < length)
+			continue;
+		return section_data(section) + offset;
+	}
+
+	// the headers are mapped at the same offset in the file and in memory
+	if (sections.empty() || rva + uint64_t(length) <= sections.front().raw_offset)
+		return rva < size && size - rva >= length ? data + rva : nullptr;
+	return nullptr;
+}
+
+std::string_view PEImage::rva_to_string(uint32_t rva) const
+{
+	const uint8_t* start = nullptr;
+	size_t available = 0;
+	if (is_loaded) {
+		if (rva < size) {
+			start = data + rva;
+			available = size - rva;
+		}
+	}
+	else {
+		for (const auto& section : sections) {
+			if (rva < section.virtual_address || rva - section.virtual_address >= section_data_size(section))
+				continue;
+			start = section_data(section) + (rva - section.virtual_address);
+			available = section_data_size(section) - (rva - section.virtual_address);
+			break;
+		}
+		const size_t headers_size = sections.empty() ? size : std::min<size_t>(size, sections.front().raw_offset);
+		if (!start && rva < headers_size) {
+			start = data + rva;
+			available = headers_size - rva;
+		}
+	}
+
+	const void* end = start ? memchr(start, 0, available) : nullptr;
+	if (!end)
+		return std::string_view{};
+	return std::string_view(reinterpret_cast<const char*>(start), static_cast<const uint8_t*>(end) - start);
+}
+
+std::vector<uint32_t> PEImage::get_relocations() const
+{
+	const DataDirectory directory = get_directory(directory_base_relocation);
+	const uint8_t* blocks = directory.size ? rva_to_pointer(directory.virtual_address, directory.size) : nullptr;
+	if (!blocks)
+		return std::vector<uint32_t>{};
+	return parse_relocations(blocks, directory.size);
+}
+
+std::vector<uint32_t> PEImage::parse_relocations(const uint8_t* blocks, uint32_t size)
+{
+	std::vector<uint32_t> relocations;
+	relocations.reserve(size / sizeof(uint16_t));
+
+	// each block is the RVA of a page and its size, followed by 16-bit entries of a type and an offset into the page
+	uint32_t offset = 0;
+	while (size - offset >= 8) {
+		uint32_t page_rva = 0;
+		uint32_t block_size = 0;
+		read_value(blocks, size, offset, page_rva);
+		read_value(blocks, size, offset + 4, block_size);
+		if (block_size < 8 || block_size > size - offset)
+			break;
+
+		const uint8_t* entries = blocks + offset + 8;
+		for (uint32_t i = 0; i < (block_size - 8) / sizeof(uint16_t); i++) {
+			uint16_t entry;
+			memcpy(&entry, entries + i * sizeof(uint16_t), sizeof(entry));
+			const uint16_t type = entry >> 12;
+			if (type == relocation_highlow || type == relocation_dir64)
+				relocations.push_back(page_rva + (entry & 0xFFF));
+		}
+		offset += block_size;
+	}
+
+	// the blocks are usually in order already
+	if (!std::is_sorted(relocations.begin(), relocations.end()))
+		std::sort(relocations.begin(), relocations.end());
+	return relocations;
+}
@@ -0,0 +1,103 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <optional>
+#include <string_view>
+
+/*
+	Minimal PE header parser that works on a loaded module or on the raw file contents.
+	Doesn't use any windows headers so it can be used to inspect executables on any platform.
+*/
+class PEImage
+{
+public:
+	static constexpr uint32_t section_code = 0x00000020;
+	static constexpr uint32_t section_executable = 0x20000000;
+	static constexpr uint32_t section_readable = 0x40000000;
+	static constexpr uint32_t section_writable = 0x80000000;
+
+	static constexpr size_t directory_export = 0;
+	static constexpr size_t directory_base_relocation = 5;
+
+	static constexpr uint16_t relocation_highlow = 3;
+	static constexpr uint16_t relocation_dir64 = 10;
+
+	struct Section
+	{
+		char name[9];
+		uint32_t virtual_address;
+		uint32_t virtual_size;
+		uint32_t raw_offset;
+		uint32_t raw_size;
+		uint32_t characteristics;
+	};
+
+	struct DataDirectory
+	{
+		uint32_t virtual_address;
+		uint32_t size;
+	};
+
+	/*
+		Parses the headers of the image in `data`, `is_loaded` should be set if the sections are at their virtual addresses
+		(e.g. a module loaded by windows) instead of their file offsets.
+	*/
+	static std::optional<PEImage> parse(const uint8_t* data, size_t size, bool is_loaded);
+
+	/*
+		Returns a pointer to `length` bytes at `rva`, or null if they aren't all backed by data in the image
+	*/
+	const uint8_t* rva_to_pointer(uint32_t rva, uint32_t length = 1) const;
+
+	/*
+		Returns the null terminated string at `rva`, or an empty string if it isn't terminated before the data runs out
+	*/
+	std::string_view rva_to_string(uint32_t rva) const;
+
+	/*
+		Pointer to the data of a section and how many bytes of it are backed by the image
+	*/
+	const uint8_t* section_data(const Section& section) const;
+	uint32_t section_data_size(const Section& section) const;
+
+	const std::vector<Section>& get_sections() const {
+		return sections;
+	}
+
+	/*
+		Returns the sorted RVAs of every absolute address the base relocations fix up, empty if they were stripped
+	*/
+	std::vector<uint32_t> get_relocations() const;
+
+	/*
+		Same as above for the base relocation blocks at `blocks`, which don't need to be in an image any more
+	*/
+	static std::vector<uint32_t> parse_relocations(const uint8_t* blocks, uint32_t size);
+
+	DataDirectory get_directory(size_t index) const {
+		if (index >= directories.size())
+			return {};
+		return directories[index];
+	}
+
+	uint64_t image_base;
+	uint32_t image_size;
+	uint32_t section_alignment;
+	uint32_t timestamp;
+	uint32_t checksum;
+	bool is_64bit;
+
+private:
+	const uint8_t* data;
+	size_t size;
+	bool is_loaded;
+	std::vector<Section> sections;
+	std::vector<DataDirectory> directories;
+};
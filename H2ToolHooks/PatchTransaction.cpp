@@ -0,0 +1,336 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#include "PatchTransaction.h"
+#include "platform.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cinttypes>
+#endif
+
+void PatchTransaction::write_bytes(uintptr_t address, const void* data, size_t size)
+{
+	if (size == 0)
+		return;
+	writes.push_back({ address, bytes.size(), size });
+	const auto source = static_cast<const uint8_t*>(data);
+	bytes.insert(bytes.end(), source, source + size);
+	// filled in with the original bytes when this is committed
+	bytes.resize(bytes.size() + size);
+}
+
+void PatchTransaction::nop_fill(uintptr_t address, size_t size)
+{
+	if (size == 0)
+		return;
+	writes.push_back({ address, bytes.size(), size });
+	bytes.insert(bytes.end(), size, 0x90);
+	bytes.resize(bytes.size() + size);
+}
+
+// the displacement is relative to the end of the 5 byte instruction
+static int32_t get_branch_displacement(uintptr_t address, uintptr_t target)
+{
+	return static_cast<int32_t>(target - (address + 5));
+}
+
+void PatchTransaction::patch_call(uintptr_t address, uintptr_t target)
+{
+	write_value(address + 1, get_branch_displacement(address, target));
+}
+
+static void write_branch(PatchTransaction& transaction, uint8_t opcode, uintptr_t address, uintptr_t target)
+{
+	uint8_t instruction[5] = { opcode };
+	const int32_t displacement = get_branch_displacement(address, target);
+	memcpy(&instruction[1], &displacement, sizeof(displacement));
+	transaction.write_bytes(address, instruction, sizeof(instruction));
+}
+
+void PatchTransaction::write_jmp(uintptr_t address, uintptr_t target)
+{
+	write_branch(*this, 0xE9, address, target);
+}
+
+void PatchTransaction::write_call(uintptr_t address, uintptr_t target)
+{
+	write_branch(*this, 0xE8, address, target);
+}
+
+void PatchTransaction::patch_abs_call(uintptr_t address, uintptr_t target)
+{
+	write_call(address, target);
+	nop_fill(address + 5, 1);
+}
+
+void PatchTransaction::read_bytes(uintptr_t address, void* data, size_t size) const
+{
+	const auto out = static_cast<uint8_t*>(data);
+	memcpy(out, reinterpret_cast<const void*>(address), size);
+	// the committed writes are already in memory, the pending ones go over it in the order they were made
+	for (size_t i = committed_count; i < writes.size(); i++) {
+		const Write& write = writes[i];
+		if (!write.overlaps(address, size))
+			continue;
+		const uintptr_t start = std::max(address, write.address);
+		const uintptr_t end = std::min(address + size, write.address + write.size);
+		memcpy(out + (start - address), &bytes[write.offset + (start - write.address)], static_cast<size_t>(end - start));
+	}
+}
+
+bool PatchTransaction::find_page_runs(size_t first_write, size_t last_write, std::vector<PageRun>& runs) const
+{
+	const uintptr_t page_size = protection.get_page_size();
+	const uintptr_t page_mask = ~(page_size - 1);
+
+	std::vector<std::pair<uintptr_t, uintptr_t>> spans;
+	spans.reserve(last_write - first_write);
+	for (size_t i = first_write; i < last_write; i++)
+		spans.push_back({ writes[i].address & page_mask, ((writes[i].address + writes[i].size - 1) & page_mask) + page_size });
+	std::sort(spans.begin(), spans.end());
+
+	// end of the protection region the last run is in
+	uintptr_t region_end = 0;
+	for (const auto& span : spans) {
+		uintptr_t address = span.first;
+		// the pages between writes have the same protection as the ones around them, so changing them too saves starting a new run
+		if (!runs.empty() && address < region_end) {
+			PageRun& run = runs.back();
+			const uintptr_t end = std::min(span.second, region_end);
+			if (end > run.address + run.size)
+				run.size = static_cast<size_t>(end - run.address);
+			address = std::max(address, end);
+		}
+
+		// a span can still cross into pages with another protection, each part has to go back to what it was
+		while (address < span.second) {
+			uint32_t page_protection;
+			const size_t same_size = protection.query(address, page_protection);
+			if (same_size == 0)
+				return false;
+			region_end = address + same_size;
+			const uintptr_t end = std::min(span.second, region_end);
+			runs.push_back({ address, static_cast<size_t>(end - address), page_protection });
+			address = end;
+		}
+	}
+	return true;
+}
+
+template <typename Apply>
+bool PatchTransaction::with_writable_pages(size_t first_write, size_t last_write, const Apply& apply)
+{
+	std::vector<PageRun> runs;
+	bool is_ok = find_page_runs(first_write, last_write, runs);
+	size_t writable_runs = 0;
+	while (is_ok && writable_runs < runs.size()) {
+		const PageRun& run = runs[writable_runs];
+		is_ok = protection.make_writable(run.address, run.size, run.protection);
+		if (is_ok)
+			writable_runs++;
+	}
+
+	if (is_ok)
+		apply();
+
+	for (size_t i = 0; i < writable_runs; i++)
+		protection.restore(runs[i].address, runs[i].size, runs[i].protection);
+
+	// the runs are in address order
+	if (is_ok)
+		protection.flush_instruction_cache(runs.front().address, runs.back().address + runs.back().size - runs.front().address);
+	return is_ok;
+}
+
+void PatchTransaction::truncate(size_t count)
+{
+	if (count < writes.size()) {
+		bytes.resize(writes[count].offset);
+		writes.resize(count);
+	}
+}
+
+bool PatchTransaction::commit()
+{
+	if (get_pending_count() == 0)
+		return true;
+
+	const bool is_ok = with_writable_pages(committed_count, writes.size(), [this]() {
+		for (size_t i = committed_count; i < writes.size(); i++) {
+			const Write& write = writes[i];
+			uint8_t* new_bytes = bytes.data() + write.offset;
+			memcpy(new_bytes + write.size, reinterpret_cast<const void*>(write.address), write.size);
+			memcpy(reinterpret_cast<void*>(write.address), new_bytes, write.size);
+		}
+	});
+
+	if (is_ok)
+		committed_count = writes.size();
+	else
+		discard();
+	return is_ok;
+}
+
+void PatchTransaction::discard()
+{
+	truncate(committed_count);
+}
+
+bool PatchTransaction::verify() const
+{
+	for (size_t i = 0; i < committed_count; i++) {
+		const Write& write = writes[i];
+		const uint8_t* new_bytes = bytes.data() + write.offset;
+		const auto memory = reinterpret_cast<const uint8_t*>(write.address);
+		if (memcmp(memory, new_bytes, write.size) == 0)
+			continue;
+
+		// the bytes that are different might belong to a later write
+		for (size_t offset = 0; offset < write.size; offset++) {
+			if (memory[offset] == new_bytes[offset])
+				continue;
+			const auto later = std::find_if(writes.begin() + i + 1, writes.begin() + committed_count, [&](const Write& other) {
+				return other.overlaps(write.address + offset, 1);
+			});
+			if (later == writes.begin() + committed_count)
+				return false;
+		}
+	}
+	return true;
+}
+
+bool PatchTransaction::rollback()
+{
+	discard();
+	if (committed_count == 0)
+		return true;
+
+	const bool is_ok = with_writable_pages(0, committed_count, [this]() {
+		for (size_t i = committed_count; i-- > 0;) {
+			const Write& write = writes[i];
+			memcpy(reinterpret_cast<void*>(write.address), bytes.data() + write.offset + write.size, write.size);
+		}
+	});
+
+	if (is_ok) {
+		committed_count = 0;
+		truncate(0);
+	}
+	return is_ok;
+}
+
+#ifdef _WIN32
+/*
+	Only executable pages are made executable, and copy-on-write pages stay copy-on-write so writing to them doesn't
+	change the protection of the file mapping they came from
+*/
+static DWORD get_writable_protection(DWORD protection)
+{
+	switch (protection & 0xFF) {
+	case PAGE_EXECUTE:
+	case PAGE_EXECUTE_READ:
+	case PAGE_EXECUTE_READWRITE:
+		return PAGE_EXECUTE_READWRITE;
+	case PAGE_EXECUTE_WRITECOPY:
+		return PAGE_EXECUTE_WRITECOPY;
+	case PAGE_WRITECOPY:
+		return PAGE_WRITECOPY;
+	default:
+		return PAGE_READWRITE;
+	}
+}
+
+class VirtualProtectMemory : public MemoryProtection
+{
+public:
+	size_t get_page_size() const override {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwPageSize;
+	}
+
+	size_t query(uintptr_t address, uint32_t& protection) const override {
+		MEMORY_BASIC_INFORMATION info;
+		if (VirtualQuery(reinterpret_cast<void*>(address), &info, sizeof(info)) == 0 || info.State != MEM_COMMIT)
+			return 0;
+		protection = info.Protect;
+		return reinterpret_cast<uintptr_t>(info.BaseAddress) + info.RegionSize - address;
+	}
+
+	bool make_writable(uintptr_t address, size_t size, uint32_t protection) override {
+		DWORD old_protection;
+		return VirtualProtect(reinterpret_cast<void*>(address), size, get_writable_protection(protection), &old_protection) != FALSE;
+	}
+
+	bool restore(uintptr_t address, size_t size, uint32_t protection) override {
+		DWORD old_protection;
+		return VirtualProtect(reinterpret_cast<void*>(address), size, protection, &old_protection) != FALSE;
+	}
+
+	void flush_instruction_cache(uintptr_t address, size_t size) override {
+		FlushInstructionCache(GetCurrentProcess(), reinterpret_cast<void*>(address), size);
+	}
+};
+
+MemoryProtection& MemoryProtection::current_process()
+{
+	static VirtualProtectMemory protection;
+	return protection;
+}
+#else
+class MprotectMemory : public MemoryProtection
+{
+public:
+	size_t get_page_size() const override {
+		return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	}
+
+	size_t query(uintptr_t address, uint32_t& protection) const override {
+		// mprotect can't report the old protection, but the kernel lists every mapping
+		FILE* maps = fopen("/proc/self/maps", "r");
+		if (!maps)
+			return 0;
+
+		size_t same_size = 0;
+		char line[0x200];
+		while (fgets(line, sizeof(line), maps)) {
+			uintmax_t start, end;
+			char permissions[5];
+			if (sscanf(line, "%" SCNxMAX "-%" SCNxMAX " %4s", &start, &end, permissions) != 3 || address < start || address >= end)
+				continue;
+			protection = (permissions[0] == 'r' ? PROT_READ : 0) | (permissions[1] == 'w' ? PROT_WRITE : 0) | (permissions[2] == 'x' ? PROT_EXEC : 0);
+			same_size = static_cast<size_t>(end - address);
+			break;
+		}
+		fclose(maps);
+		return same_size;
+	}
+
+	bool make_writable(uintptr_t address, size_t size, uint32_t protection) override {
+		return mprotect(reinterpret_cast<void*>(address), size, static_cast<int>(protection) | PROT_READ | PROT_WRITE) == 0;
+	}
+
+	bool restore(uintptr_t address, size_t size, uint32_t protection) override {
+		return mprotect(reinterpret_cast<void*>(address), size, static_cast<int>(protection)) == 0;
+	}
+
+	void flush_instruction_cache(uintptr_t address, size_t size) override {
+		__builtin___clear_cache(reinterpret_cast<char*>(address), reinterpret_cast<char*>(address + size));
+	}
+};
+
+MemoryProtection& MemoryProtection::current_process()
+{
+	static MprotectMemory protection;
+	return protection;
+}
+#endif
@@ -0,0 +1,200 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*
+	Changes the protection of pages in the current process, the transactions go through this so they can be run
+	against any memory (and on any platform) without knowing how it's protected
+*/
+class MemoryProtection
+{
+public:
+	virtual ~MemoryProtection() = default;
+
+	virtual size_t get_page_size() const = 0;
+
+	/*
+		Gets the protection of the page at `address`, returns how many bytes from `address` have the same protection or zero if it isn't mapped
+	*/
+	virtual size_t query(uintptr_t address, uint32_t& protection) const = 0;
+
+	/*
+		Makes whole pages writable, keeping the rest of their `protection` from `query`
+	*/
+	virtual bool make_writable(uintptr_t address, size_t size, uint32_t protection) = 0;
+
+	/*
+		Sets whole pages back to a protection from `query`
+	*/
+	virtual bool restore(uintptr_t address, size_t size, uint32_t protection) = 0;
+
+	virtual void flush_instruction_cache(uintptr_t address, size_t size) = 0;
+
+	/*
+		VirtualProtect on windows, mprotect elsewhere
+	*/
+	static MemoryProtection& current_process();
+};
+
+/*
+	Collects writes to code and data and applies them all at once. The pages written to are made writable and restored
+	once per run of pages with the same protection (taking the untouched pages between writes along with them),
+	however many writes there are, and the instruction cache is flushed once at the end.
+	Writes are applied in the order they were made, so a later write to the same bytes wins.
+
+	Committed writes stay in a journal with the bytes they replaced, so they can be checked and undone together.
+	Both the new and the original bytes of every write are kept in one buffer, which is only ever appended to.
+*/
+class PatchTransaction
+{
+public:
+	explicit PatchTransaction(MemoryProtection& protection = MemoryProtection::current_process()) :
+		protection(protection)
+	{}
+
+	PatchTransaction(const PatchTransaction&) = delete;
+	PatchTransaction& operator=(const PatchTransaction&) = delete;
+
+	/*
+		Anything not committed yet is dropped, memory is only ever written by an explicit commit
+	*/
+	~PatchTransaction() {
+		discard();
+	}
+
+	void write_bytes(uintptr_t address, const void* bytes, size_t size);
+
+	template <typename value_type>
+	void write_value(uintptr_t address, value_type value) {
+		write_bytes(address, &value, sizeof(value));
+	}
+
+	/*
+		Writes a pointer sized value at `address`
+	*/
+	void write_pointer(uintptr_t address, const void* pointer) {
+		write_value(address, pointer);
+	}
+
+	/*
+		Writes `size` nops at `address`
+	*/
+	void nop_fill(uintptr_t address, size_t size);
+
+	/*
+		Writes nops from `start` up to `end`
+	*/
+	void nop_fill_range(uintptr_t start, uintptr_t end) {
+		if (end > start)
+			nop_fill(start, static_cast<size_t>(end - start));
+	}
+
+	/*
+		Points the existing `call rel32` or `jmp rel32` at `address` to `target`, only the displacement is written
+	*/
+	void patch_call(uintptr_t address, uintptr_t target);
+
+	/*
+		Writes a whole `jmp rel32` or `call rel32` to `target` at `address`
+	*/
+	void write_jmp(uintptr_t address, uintptr_t target);
+	void write_call(uintptr_t address, uintptr_t target);
+
+	/*
+		Replaces the 6 byte `call [absolute]` at `address` with a `call rel32` to `target` and a nop
+	*/
+	void patch_abs_call(uintptr_t address, uintptr_t target);
+
+	/*
+		Reads memory the way it will be once the pending writes are committed, so a hook can build on what another queued
+	*/
+	void read_bytes(uintptr_t address, void* data, size_t size) const;
+
+	template <typename value_type>
+	value_type read_value(uintptr_t address) const {
+		value_type value;
+		read_bytes(address, &value, sizeof(value));
+		return value;
+	}
+
+	/*
+		Applies the writes made since the last commit, returns false if a page couldn't be made writable.
+		Nothing is written unless every page could be, and the writes that weren't are dropped.
+	*/
+	bool commit();
+
+	/*
+		Drops the writes made since the last commit
+	*/
+	void discard();
+
+	/*
+		Checks every committed write is still in memory without touching the page protection.
+		Where writes overlap only the bytes of the last one to write them are checked.
+	*/
+	bool verify() const;
+
+	/*
+		Puts back the bytes every committed write replaced, newest first, and empties the journal.
+		Uncommitted writes are discarded. Returns false and leaves the journal alone if a page couldn't be made writable.
+	*/
+	bool rollback();
+
+	size_t get_pending_count() const {
+		return writes.size() - committed_count;
+	}
+
+	size_t get_committed_count() const {
+		return committed_count;
+	}
+
+private:
+	/*
+		The new bytes are at `offset` in `bytes` and the ones they replaced straight after them
+	*/
+	struct Write
+	{
+		uintptr_t address;
+		size_t offset;
+		size_t size;
+
+		bool overlaps(uintptr_t other_address, size_t other_size) const {
+			return other_address < address + size && address < other_address + other_size;
+		}
+	};
+
+	/*
+		Pages with the same protection that are made writable and restored together
+	*/
+	struct PageRun
+	{
+		uintptr_t address;
+		size_t size;
+		uint32_t protection;
+	};
+
+	bool find_page_runs(size_t first_write, size_t last_write, std::vector<PageRun>& runs) const;
+
+	/*
+		Makes the pages for writes [`first_write`, `last_write`) writable, calls `apply` and puts the protection back
+	*/
+	template <typename Apply>
+	bool with_writable_pages(size_t first_write, size_t last_write, const Apply& apply);
+
+	/*
+		Truncates the journal to the first `count` writes
+	*/
+	void truncate(size_t count);
+
+	MemoryProtection& protection;
+	std::vector<Write> writes;
+	std::vector<uint8_t> bytes;
+	size_t committed_count = 0;
+};
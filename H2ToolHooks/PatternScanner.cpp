@@ -5,55 +5,205 @@
 */
 
 #include "PatternScanner.h"
+#include "PEImage.h"
+#include "InstructionLength.h"
 #include "platform.h"
-#include "psapi.h"
+#include <functional>
+
+std::pair<const PatternScanner::CallSite*, const PatternScanner::CallSite*> PatternScanner::find_call_sites(image_address target) const {
+	std::call_once(call_index_built, [this]() {
+		for (const auto& range : code) {
+			const uint8_t* last = range.size >= 5 ? range.end() - 4 : range.data;
+			for (auto call = range.data; call < last; call++) {
+				call = static_cast<const uint8_t*>(memchr(call, 0xE8, last - call));
+				if (!call)
+					break;
 
-#define INSERT_INTO_RANGE_LIST(list, memory_info) \
-	list.push_back(std::pair<uint32_t, uint32_t>(uint32_t(memory_info.BaseAddress), memory_info.RegionSize));
+				int32_t displacement;
+				memcpy(&displacement, call + 1, sizeof(displacement));
+				const image_address address = range.address + static_cast<uint32_t>(call - range.data);
+				const image_address call_target = address + 5 + displacement;
+				// most E8 bytes aren't calls, but the ones that are point back into the code
+				if (find_segment(code, call_target))
+					call_index.push_back({ static_cast<uint32_t>(call_target - module_base), static_cast<uint32_t>(address - module_base) });
+			}
+		}
+		std::sort(call_index.begin(), call_index.end());
+	});
 
-static inline size_t align(size_t value, size_t alignment)
-{
-	return value & ~(alignment - 1);
+	if (!is_in_module(target))
+		return { nullptr, nullptr };
+	const uint32_t target_rva = static_cast<uint32_t>(target - module_base);
+	const auto first = std::lower_bound(call_index.begin(), call_index.end(), CallSite{ target_rva, 0 });
+	const auto last = std::upper_bound(first, call_index.end(), CallSite{ target_rva, UINT32_MAX });
+	return { call_index.data() + (first - call_index.begin()), call_index.data() + (last - call_index.begin()) };
 }
 
-PatternScanner::PatternScanner() {
-	MODULEINFO module_info;
-	ZeroMemory(&module_info, sizeof(module_info));
-	GetModuleInformation(GetCurrentProcess(), GetModuleHandle(NULL), &module_info, sizeof(module_info));
-	module_base = size_t(module_info.lpBaseOfDll);
-	module_size = module_info.SizeOfImage;
+std::vector<image_address> PatternScanner::get_callers(image_address target) const {
+	// the index is built now anyway, so patterns with a call can use it from here on
+	call_target_lookups.fetch_add(1, std::memory_order_relaxed);
+	const auto call_sites = find_call_sites(target);
+	std::vector<image_address> callers;
+	callers.reserve(call_sites.second - call_sites.first);
+	for (const CallSite* call = call_sites.first; call != call_sites.second; call++)
+		callers.push_back(module_base + call->address);
+	return callers;
+}
+
+void PatternScanner::build_relocation_index() const {
+	std::call_once(relocation_index_built, [this]() {
+		const std::vector<uint32_t> relocations = PEImage::parse_relocations(relocation_blocks, relocation_blocks_size);
+		relocation_sites.reserve(relocations.size());
+		for (uint32_t rva : relocations)
+			relocation_sites.push_back(module_base + rva);
+	});
+}
+
+std::vector<PatternScanner::InstructionStarts>& PatternScanner::get_instruction_starts() const {
+	std::call_once(instruction_starts_built, [this]() {
+		instruction_starts.resize(code.size());
+		for (size_t i = 0; i < code.size(); i++) {
+			instruction_starts[i].bitmap.resize((size_t(code[i].size) + 63) / 64);
+			const size_t block_count = (size_t(code[i].size) + instruction_block_size - 1) / instruction_block_size;
+			instruction_starts[i].block_state.reset(new std::atomic<uint8_t>[block_count]);
+			for (size_t block = 0; block < block_count; block++)
+				instruction_starts[i].block_state[block].store(block_not_swept, std::memory_order_relaxed);
+		}
+	});
+	return instruction_starts;
+}
 
+bool PatternScanner::sweep_instruction_block(const Segment& segment, InstructionStarts& starts, size_t block, size_t offset) const {
+	// swept into a copy first, another thread could be sweeping the same block
+	uint64_t bitmap[instruction_block_size / 64] = {};
+	const size_t block_start = block * instruction_block_size;
+	const size_t block_end = std::min<size_t>(block_start + instruction_block_size, segment.size);
+	for (size_t position = block_start > instruction_block_lead_in ? block_start - instruction_block_lead_in : 0; position < block_end;) {
+		const size_t length = InstructionLength::decode(segment.data + position, segment.size - position, is_64bit);
+		if (length != 0 && position >= block_start)
+			bitmap[(position - block_start) / 64] |= uint64_t(1) << ((position - block_start) % 64);
+		// x86 falls back into step within a few instructions of garbage, so just try the next byte
+		position += length != 0 ? length : 1;
+	}
 
-	size_t page_size = 0x1000; // just presume 4k pages
-	size_t module_start = align(module_base, page_size); // align down
-	size_t module_end = align((module_size + module_base) + (page_size - 1), page_size); // align up
+	uint8_t state = block_not_swept;
+	if (starts.block_state[block].compare_exchange_strong(state, block_being_written, std::memory_order_acquire)) {
+		std::copy(bitmap, bitmap + (block_end - block_start + 63) / 64, starts.bitmap.begin() + block_start / 64);
+		starts.block_state[block].store(block_swept, std::memory_order_release);
+	}
+	return (bitmap[(offset - block_start) / 64] >> ((offset - block_start) % 64)) & 1;
+}
 
-	DebugPrintf("Module range: %x-%x", module_start, module_end);
+const std::vector<image_address>& PatternScanner::find_string_addresses(const char* string) const {
+	std::lock_guard<std::mutex> lock(string_index_lock);
 
-	auto offset = module_start;
-	while (offset < module_end) {
-		MEMORY_BASIC_INFORMATION memory_info;
-		if (VirtualQuery(LPCVOID(offset), &memory_info, sizeof(memory_info))) {
+	auto cached = string_index.find(string);
+	if (cached != string_index.end())
+		return cached->second;
 
-			if (memory_info.Protect & PAGE_EXECUTE || memory_info.Protect & PAGE_EXECUTE_READ
-					|| memory_info.Protect & PAGE_EXECUTE_READWRITE || memory_info.Protect & PAGE_EXECUTE_WRITECOPY)
-				INSERT_INTO_RANGE_LIST(this->code, memory_info)
-			if (memory_info.Protect == PAGE_READWRITE || memory_info.Protect == PAGE_WRITECOPY)
-				INSERT_INTO_RANGE_LIST(this->data, memory_info)
-			if (memory_info.Protect == PAGE_READONLY)
-				INSERT_INTO_RANGE_LIST(this->rdata, memory_info)
+	// include the terminator so only whole strings (or the tail of a longer one, like the linker might share) match
+	const size_t length = strlen(string) + 1;
+	const auto string_bytes = reinterpret_cast<const uint8_t*>(string);
+	const std::boyer_moore_horspool_searcher searcher(string_bytes, string_bytes + length);
 
-			offset = (size_t)memory_info.BaseAddress + memory_info.RegionSize;
-		}
+	std::vector<image_address> addresses;
+	for (const auto& range : rdata) {
+		for (auto found = std::search(range.data, range.end(), searcher); found != range.end(); found = std::search(found + 1, range.end(), searcher))
+			addresses.push_back(range.address + static_cast<uint32_t>(found - range.data));
+	}
+
+	return string_index.emplace(string, std::move(addresses)).first->second;
+}
+
+PatternScanner::PatternScanner(const PEImage& image) {
+	module_base = image.image_base;
+	module_size = image.image_size;
+	is_64bit = image.is_64bit;
+	identity = { image.timestamp, image.checksum, image.image_size };
+	load_sections(image);
+}
+
+void PatternScanner::load_sections(const PEImage& image) {
+	std::vector<PEImage::Section> sections = image.get_sections();
+	std::sort(sections.begin(), sections.end(), [](const PEImage::Section& a, const PEImage::Section& b) {
+		return a.virtual_address < b.virtual_address;
+	});
+
+	for (const auto& section : sections) {
+		const Segment segment = { module_base + section.virtual_address, image.section_data_size(section), image.section_data(section) };
+		if (segment.size == 0)
+			continue;
+
+		range_list* list;
+		if (section.characteristics & PEImage::section_executable)
+			list = &code;
+		else if (section.characteristics & PEImage::section_writable)
+			list = &data;
+		else if (section.characteristics & PEImage::section_readable)
+			list = &rdata;
 		else
-		{
-#if _DEBUG
-			DebugPrintf("Failed to get memory info for %x", offset);
-#endif
-			// try next page anyways
-			offset += page_size;
+			continue;
+
+		// sections are padded up to the alignment, when the padding is backed by the same buffer the two can be merged
+		if (!list->empty()) {
+			Segment& previous = list->back();
+			const image_address gap = segment.address - previous.address;
+			if (gap >= previous.size && gap - previous.size < image.section_alignment && segment.data == previous.data + gap) {
+				previous.size = static_cast<uint32_t>(gap + segment.size);
+				continue;
+			}
+		}
+		list->push_back(segment);
+	}
+
+	// parsed when a pattern first needs them, the blocks stay mapped as long as the sections do
+	const PEImage::DataDirectory relocations = image.get_directory(PEImage::directory_base_relocation);
+	relocation_blocks = relocations.size ? image.rva_to_pointer(relocations.virtual_address, relocations.size) : nullptr;
+	relocation_blocks_size = relocation_blocks ? relocations.size : 0;
+
+	// the lists don't change after this, so the page table can point into them
+	uint32_t table_size = 0;
+	for (const range_list* list : { &code, &data, &rdata }) {
+		for (const auto& segment : *list)
+			table_size = std::max(table_size, static_cast<uint32_t>(segment.address - module_base + segment.size));
+	}
+	page_table.assign((size_t(table_size) + (1 << page_shift) - 1) >> page_shift, page_unmapped);
+
+	for (const range_list* list : { &code, &data, &rdata }) {
+		for (const auto& segment : *list) {
+			page_owners.push_back({ list, &segment });
+			const uint8_t owner = page_owners.size() < page_shared ? static_cast<uint8_t>(page_owners.size()) : page_shared;
+
+			const uint32_t first_page = static_cast<uint32_t>((segment.address - module_base) >> page_shift);
+			const uint32_t last_page = static_cast<uint32_t>((segment.address - module_base + segment.size - 1) >> page_shift);
+			for (uint32_t page = first_page; page <= last_page; page++)
+				page_table[page] = page_table[page] == page_unmapped ? owner : page_shared;
 		}
 	}
 }
 
-#undef INSERT_INTO_RANGE_LIST
\ No newline at end of file
+#ifdef _WIN32
+#include "psapi.h"
+
+PatternScanner::PatternScanner() {
+	MODULEINFO module_info;
+	ZeroMemory(&module_info, sizeof(module_info));
+	GetModuleInformation(GetCurrentProcess(), GetModuleHandle(NULL), &module_info, sizeof(module_info));
+	module_base = reinterpret_cast<uintptr_t>(module_info.lpBaseOfDll);
+	module_size = module_info.SizeOfImage;
+
+	LOG_DEBUG("Module range: %llx-%llx", module_base, module_base + module_size);
+
+	// the loader maps every section at its virtual address, so the layout can be read from the headers in memory
+	auto image = PEImage::parse(reinterpret_cast<const uint8_t*>(static_cast<uintptr_t>(module_base)), module_size, true);
+	if (!image) {
+		LOG_ERROR("Failed to parse the module headers!");
+		identity = {};
+		return;
+	}
+
+	identity = { image->timestamp, image->checksum, image->image_size };
+	is_64bit = image->is_64bit;
+	load_sections(*image);
+}
+#endif
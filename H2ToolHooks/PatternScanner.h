@@ -7,291 +7,1418 @@
 #pragma once
 #include <tuple>
 #include <vector>
-#include <memory>
 #include <array>
 #include <optional>
+#include <utility>
+#include <type_traits>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <iterator>
+#include <memory>
 #include "Debug.h"
+#include "AnchorPrefilter.h"
+#include "ScanStats.h"
 
-inline static uint32_t get_function_address_from_call(uint32_t call) {
-	return *reinterpret_cast<uint32_t*>(call + 1) + (call + 5);
+inline static uintptr_t get_function_address_from_call(uintptr_t call) {
+	// the displacement is signed, which matters once addresses are wider than it
+	return call + 5 + *reinterpret_cast<int32_t*>(call + 1);
 }
 
+/*
+	An address in the scanned image, 64-bit so x64 images can be scanned from either kind of process
+*/
+typedef uint64_t image_address;
 
-#define PAT_UNI(type, ...) \
-	std::make_unique<type>(type(##__VA_ARGS__))
 
-class PatternScanner;
+class PEImage;
 
-class PatternEntryBase
+class PatternScanner
 {
-public:
-	virtual size_t entry_size() const = 0;
-	virtual bool matches(const PatternScanner& scanner, const uint8_t* data) const = 0;
-	virtual size_t size_required() const {
-		return entry_size();
-	}
-};
+	/*
+		A block of the image, `address` is where it is (or would be) loaded and `data` is where the bytes can be read from
+	*/
+	struct Segment
+	{
+		image_address address;
+		uint32_t size;
+		const uint8_t* data;
 
-typedef std::unique_ptr<PatternEntryBase> pattern_entry;
+		bool contains(image_address other_address) const {
+			return other_address >= address && other_address - address < size;
+		}
 
-class PatternScanner
-{
-	typedef std::vector<std::pair<uint32_t, uint32_t>> range_list;
+		const uint8_t* end() const {
+			return data + size;
+		}
+	};
+	typedef std::vector<Segment> range_list;
 public:
+	/*
+		Scans the executable of the current process
+	*/
 	PatternScanner();
-	bool is_in_rdata_segment(const uint8_t* pointer) const {
-		if (!is_in_module(pointer))
+	/*
+		Scans the sections of `image`, which doesn't have to be loaded (e.g. a mapped file or a buffer).
+		Addresses are reported as if it were loaded at its preferred base.
+	*/
+	explicit PatternScanner(const PEImage& image);
+
+	bool is_in_rdata_segment(image_address address) const {
+		if (!is_in_module(address))
 			return false;
-		return in_range_list(rdata, pointer);
+		return find_segment(rdata, address) != nullptr;
+	}
+	bool is_in_module(image_address address) const {
+		return address >= module_base && address - module_base < module_size;
+	}
+
+	/*
+		Returns where the data at `address` can be read from, or null if it isn't in the image
+	*/
+	const uint8_t* translate_address(image_address address) const {
+		const Segment* segment = find_segment(address);
+		return segment ? segment->data + (address - segment->address) : nullptr;
+	}
+
+	/*
+		Returns the target of the `call`/`jmp rel32` at `address` if the instruction is in the image
+	*/
+	std::optional<image_address> get_call_target(image_address address) const {
+		const uint8_t* instruction = translate_address(address);
+		if (!instruction || !translate_address(address + 4))
+			return std::optional<image_address>{};
+		int32_t displacement;
+		memcpy(&displacement, instruction + 1, sizeof(displacement));
+		return address + 5 + displacement;
 	}
-	bool is_in_module(const uint8_t* pointer) const {
-		return in_range(pointer, module_base, module_size);
+
+	/*
+		Returns the address of every `call rel32` to `target` in the code.
+		All the calls are decoded into an index the first time this is used, which is then shared by every later lookup.
+	*/
+	std::vector<image_address> get_callers(image_address target) const;
+
+	/*
+		Sorted addresses of every absolute pointer in the image according to the base relocations, empty if they were stripped
+	*/
+	const std::vector<image_address>& get_relocation_sites() const {
+		build_relocation_index();
+		return relocation_sites;
+	}
+
+	/*
+		Returns every address in rdata that holds a copy of `string`, it's only searched for once per scanner
+	*/
+	const std::vector<image_address>& find_string_addresses(const char* string) const;
+
+	/*
+		Checks if `address` points at a copy of `string` in rdata
+	*/
+	bool is_string_at(image_address address, const char* string) const {
+		if (!is_in_module(address))
+			return false;
+		const Segment* segment = find_segment(rdata, address);
+		if (!segment)
+			return false;
+		const size_t offset = address - segment->address;
+		const size_t length = strlen(string) + 1;
+		return segment->size - offset >= length && memcmp(segment->data + offset, string, length) == 0;
 	}
 
 	struct Match
 	{
-		uint32_t offset;
+		image_address offset;
 		uint32_t length;
 	};
 
+	/*
+		Cheap to get values from the PE header that change whenever the executable is rebuilt
+	*/
+	struct ModuleIdentity
+	{
+		uint32_t timestamp;
+		uint32_t checksum;
+		uint32_t image_size;
 
-	template <size_t pattern_size>
-	std::optional<Match> find_pattern_in_code(const std::array<pattern_entry, pattern_size> &pattern) const {
-		std::vector<Match> matches = find_pattern_in_code_multiple<pattern_size>(pattern, 1);
-		if (matches.empty())
-			return std::optional<Match>{};
-		return matches[0];
+		bool operator==(const ModuleIdentity& other) const {
+			return timestamp == other.timestamp && checksum == other.checksum && image_size == other.image_size;
+		}
+	};
+
+	const ModuleIdentity& get_module_identity() const {
+		return identity;
 	}
 
-	template <size_t pattern_size>
-	std::optional<Match> find_pattern_in_rdata(const std::array<pattern_entry, pattern_size>& pattern) const {
+	image_address get_module_base() const {
+		return module_base;
+	}
 
-		std::vector<Match> instances;
-		instances.reserve(1);
+	/*
+		Only try patterns at the start of an instruction when they are in the code, patterns then have to start on one.
+		The starts come from a linear sweep over the code, done a block at a time as they are needed and shared by every pattern.
+		The sweep steps over bytes that don't decode, so it can briefly be out of step after data in the code (e.g. a jump table).
+	*/
+	void set_instruction_boundaries_only(bool enabled) {
+		instruction_boundaries_only = enabled;
+	}
 
-		for (const auto& range : rdata) {
-			auto range_end = range.first + range.second;
-			if (find_pattern_in_range_internal(instances, range.first, range_end, pattern, 1))
-			{
-				return instances[0];
-			}
+	/*
+		Checks if the sweep found an instruction starting at `address`, anything outside the code counts as a start.
+		Only the block around `address` is swept if it hasn't been yet, so checking a single address stays cheap.
+	*/
+	bool is_instruction_start(image_address address) const {
+		const Segment* segment = find_segment(code, address);
+		if (!segment)
+			return true;
+		InstructionStarts& starts = get_instruction_starts()[segment - code.data()];
+		const size_t offset = static_cast<size_t>(address - segment->address);
+		const size_t block = offset / instruction_block_size;
+		if (starts.block_state[block].load(std::memory_order_acquire) != block_swept)
+			return sweep_instruction_block(*segment, starts, block, offset);
+		return (starts.bitmap[offset / 64] >> (offset % 64)) & 1;
+	}
+
+	/*
+		The scan counters from searches made while this is alive are reported under `label`, see ScanStats.h
+	*/
+	class StatsLabel
+	{
+	public:
+#if PATTERN_SCANNER_STATS
+		StatsLabel(const PatternScanner& scanner, const char* label) :
+			scanner(scanner),
+			previous_label(scanner.stats_label)
+		{
+			scanner.stats_label = label;
+		}
+
+		~StatsLabel()
+		{
+			scanner.stats_label = previous_label;
 		}
 
+	private:
+		const PatternScanner& scanner;
+		const char* previous_label;
+#else
+		StatsLabel(const PatternScanner& scanner, const char* label) {}
+#endif
+	};
+
+	/*
+		Prints the scan counters collected so far, does nothing if they are compiled out
+	*/
+	void print_stats() const {
+#if PATTERN_SCANNER_STATS
+		stats.print();
+#endif
+	}
+
+	/*
+		Checks if `pattern` matches at `address` without scanning, the whole match has to be inside one segment
+	*/
+	template <typename Pattern>
+	std::optional<Match> match_pattern_at_address(const Pattern& pattern, image_address address) const {
+		if (const Segment* segment = find_segment(address)) {
+			const auto resolved_pattern = pattern.resolve(*this);
+			ScanCounters counters("at address", address, resolved_pattern.get_size(), resolved_pattern.get_element_count());
+			Match match;
+			const bool is_match = match_pattern_at(resolved_pattern, *segment, segment->data + (address - segment->address), match, counters);
+			add_stats(counters);
+			if (is_match)
+				return match;
+		}
 		return std::optional<Match>{};
 	}
 
-	template <size_t pattern_size>
-	std::vector<Match> find_pattern_in_code_multiple(const std::array<pattern_entry, pattern_size>& pattern, size_t max_count = 0) const {
+
+	/*
+		Matches of a pattern found one at a time as the range is iterated, see MatchRange below
+	*/
+	template <typename Pattern>
+	class MatchRange;
+
+	/*
+		Lazily finds the matches in the code in address order (call order for patterns with a call), nothing is scanned
+		past the match the caller stops at. The scanner has to outlive the range.
+	*/
+	template <typename Pattern>
+	MatchRange<Pattern> find_pattern_matches_in_code(const Pattern& pattern) const {
+		return MatchRange<Pattern>(*this, pattern, code, true);
+	}
+
+	template <typename Pattern>
+	MatchRange<Pattern> find_pattern_matches_in_rdata(const Pattern& pattern) const {
+		return MatchRange<Pattern>(*this, pattern, rdata, false);
+	}
+
+	template <typename Pattern>
+	std::optional<Match> find_pattern_in_code(const Pattern &pattern) const {
+		return first_match(find_pattern_matches_in_code(pattern));
+	}
+
+	template <typename Pattern>
+	std::optional<Match> find_pattern_in_rdata(const Pattern& pattern) const {
+		return first_match(find_pattern_matches_in_rdata(pattern));
+	}
+
+	template <typename Pattern>
+	std::vector<Match> find_pattern_in_code_multiple(const Pattern& pattern, size_t max_count = 0) const {
 		std::vector<Match> instances;
+		for (const Match& match : find_pattern_matches_in_code(pattern)) {
+			instances.push_back(match);
+			if (max_count != 0 && instances.size() >= max_count)
+				break;
+		}
+		return instances;
+	}
+
+	/*
+		Same as find_pattern_in_code_multiple but splits the code into chunks and scans them on `thread_count` threads,
+		zero picks a thread count from the number of cores. Matches are returned in address order.
+		Don't call this while holding the loader lock (e.g. from DllMain), the worker threads can't start until it's released.
+	*/
+	template <typename Pattern>
+	std::vector<Match> find_pattern_in_code_multiple_parallel(const Pattern& pattern, size_t max_count = 0, size_t thread_count = 0) const {
+		struct Chunk
+		{
+			Segment segment;
+			std::vector<Match> instances;
+			bool complete;
+		};
+
+		// chunks overlap by the pattern size so matches crossing a chunk boundary are still found, but only by one chunk
+		std::vector<Chunk> chunks;
 		for (const auto& range : code) {
-			auto range_end = range.first + range.second;
-			bool exit_early = find_pattern_in_range_internal<pattern_size>(instances, range.first, range_end, pattern, max_count);
-			if (exit_early)
-				return instances;
+			for (uint32_t chunk_offset = 0; chunk_offset < range.size; chunk_offset += parallel_scan_chunk_size) {
+				auto chunk_size = std::min<uint64_t>(uint64_t(parallel_scan_chunk_size) + pattern.get_size() - 1, range.size - chunk_offset);
+				chunks.push_back({ { range.address + chunk_offset, static_cast<uint32_t>(chunk_size), range.data + chunk_offset }, {}, false });
+				if (range.size - chunk_offset <= parallel_scan_chunk_size)
+					break;
+			}
 		}
+
+		const auto resolved_pattern = pattern.resolve(*this);
+
+		size_t call_offset;
+		image_address call_target;
+		if (resolved_pattern.find_call_element(call_offset, call_target) && use_call_index()) {
+			std::vector<Match> instances;
+			find_pattern_from_call_sites(instances, resolved_pattern, call_offset, call_target, max_count);
+			return instances;
+		}
+
+		if (thread_count == 0)
+			thread_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, parallel_scan_max_threads);
+		thread_count = std::min(thread_count, chunks.size());
+
+		std::atomic<size_t> next_chunk = 0;
+		// once the first `max_count` matches are known the chunks after them don't need scanning
+		std::atomic<size_t> last_chunk_needed = chunks.size();
+		std::mutex progress_lock;
+		size_t complete_prefix = 0;
+		size_t complete_prefix_matches = 0;
+
+		auto worker = [&]() {
+			// chunks are handed out in address order, so once one isn't needed none of the later ones are
+			for (size_t index = next_chunk++; index < chunks.size() && index <= last_chunk_needed; index = next_chunk++) {
+				Chunk& chunk = chunks[index];
+				find_pattern_in_range_internal(chunk.instances, chunk.segment, resolved_pattern, max_count);
+				if (max_count == 0)
+					continue;
+
+				std::lock_guard<std::mutex> lock(progress_lock);
+				chunk.complete = true;
+				while (last_chunk_needed == chunks.size() && complete_prefix < chunks.size() && chunks[complete_prefix].complete) {
+					complete_prefix_matches += chunks[complete_prefix].instances.size();
+					if (complete_prefix_matches >= max_count)
+						last_chunk_needed = complete_prefix;
+					complete_prefix++;
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < thread_count; i++)
+			workers.emplace_back(worker);
+		worker();
+		for (auto& thread : workers)
+			thread.join();
+
+		std::vector<Match> instances;
+		for (size_t i = 0; i < chunks.size() && i <= last_chunk_needed; i++)
+			instances.insert(instances.end(), chunks[i].instances.begin(), chunks[i].instances.end());
+		if (max_count != 0 && instances.size() > max_count)
+			instances.resize(max_count);
 		return instances;
 	}
 
+	/*
+		A single pattern in a multi-pattern scan, `max_count` of zero means unlimited
+	*/
+	template <typename Pattern>
+	struct PatternSearch
+	{
+		const Pattern& pattern;
+		size_t max_count;
+	};
+
+	template <typename Pattern>
+	static PatternSearch<Pattern> search(const Pattern& pattern, size_t max_count = 0) {
+		return { pattern, max_count };
+	}
+
+	/*
+		Finds all the patterns passed in with one walk over the code segments, returns the matches for each pattern in the same order.
+		Patterns with a call or an unanchored rdata pointer are still looked up from the call sites or relocations like the
+		single pattern searches, only the rest share the walk. The first pattern with a call shares it as well, see use_call_index.
+	*/
+	template <typename... Patterns>
+	std::array<std::vector<Match>, sizeof...(Patterns)> find_patterns_in_code(const PatternSearch<Patterns>&... searches) const {
+		return find_patterns_in_ranges(code, true, searches...);
+	}
+
+	/*
+		Same as above for the rdata segments
+	*/
+	template <typename... Patterns>
+	std::array<std::vector<Match>, sizeof...(Patterns)> find_patterns_in_rdata(const PatternSearch<Patterns>&... searches) const {
+		return find_patterns_in_ranges(rdata, false, searches...);
+	}
+
 private:
+	static constexpr uint32_t parallel_scan_chunk_size = 0x40000;
+	static constexpr size_t parallel_scan_max_threads = 8;
 
-	template <size_t pattern_size>
-	bool find_pattern_in_range_internal(std::vector<Match>& instances, uint32_t range_start, uint32_t range_end, const std::array<pattern_entry, pattern_size>& pattern, size_t max_count = 0) const
+	template <typename Pattern>
+	static std::optional<Match> first_match(MatchRange<Pattern>&& matches)
 	{
-		for (auto address = range_start; address < range_end; address++) {
-			uint32_t offset = 0;
-			for (auto pat_idx = 0u; pat_idx < pattern.size(); pat_idx++) {
-				auto element_end = address + offset + pattern[pat_idx]->size_required();
-				if (element_end > range_end)
-					break;
-				if (!pattern[pat_idx]->matches(*this, reinterpret_cast<uint8_t*>(offset + address)))
-					break;
-				offset += pattern[pat_idx]->entry_size();
-				if (pat_idx == pattern.size() - 1)
-				{
-					instances.push_back({ address, offset });
+		auto first = matches.begin();
+		if (first == matches.end())
+			return std::optional<Match>{};
+		return *first;
+	}
 
-					if (max_count != 0 && instances.size() >= max_count)
-						return true;
+	template <typename Pattern>
+	bool match_pattern_at(const Pattern& pattern, const Segment& segment, const uint8_t* data, Match &match, ScanCounters& counters) const
+	{
+		if (segment.end() - data < static_cast<ptrdiff_t>(pattern.get_size()))
+			return false;
+		const image_address address = segment.address + static_cast<uint32_t>(data - segment.data);
+		if (instruction_boundaries_only && !is_instruction_start(address))
+			return false;
+#if PATTERN_SCANNER_STATS
+		const size_t rejecting_element = pattern.find_rejecting_element(*this, data, address);
+		counters.add_candidate(rejecting_element);
+		if (rejecting_element != pattern.get_element_count())
+			return false;
+#else
+		if (!pattern.matches(*this, data, address))
+			return false;
+#endif
+		match = { address, static_cast<uint32_t>(pattern.get_size()) };
+		return true;
+	}
+
+	template <typename Pattern>
+	static AnchorPrefilter build_prefilter(const Pattern& pattern)
+	{
+		AnchorPrefilter prefilter;
+		pattern.for_each_literal([&prefilter](size_t offset, uint8_t value) {
+			prefilter.add_literal(static_cast<uint32_t>(offset), value);
+		});
+		prefilter.build_skip_table();
+		return prefilter;
+	}
+
+	/*
+		Per pattern state for stepping through the candidates the prefilter finds in a range
+	*/
+	struct CandidateCursor
+	{
+		AnchorPrefilter prefilter;
+		uint32_t span;
+		const uint8_t* next;
+		const uint8_t* last;
+		// set once the pattern doesn't need any more candidates, only used by the multi-pattern scan
+		bool done;
+
+		void start(const Segment& segment) {
+			last = segment.size >= span ? segment.end() - span + 1 : segment.data;
+			next = done ? last : prefilter.next_candidate(segment.data, last);
+		}
+
+		void advance() {
+			next = prefilter.next_candidate_after(next, last);
+		}
+
+		bool exhausted() const {
+			return next >= last;
+		}
+	};
+
+	template <typename Pattern>
+	bool find_pattern_in_range_internal(std::vector<Match>& instances, const Segment& range, const Pattern& pattern, size_t max_count = 0) const
+	{
+		// without an anchor in the pointer the prefilter would check nearly every position
+		size_t pointer_offset;
+		if (relocation_blocks_size != 0 && pattern.find_unanchored_rdata_pointer(pointer_offset))
+			return find_pattern_from_relocations(instances, range, pattern, pointer_offset, max_count);
+
+		ScanCounters counters("scan", range.address, range.size, pattern.get_element_count());
+		CandidateCursor cursor = { build_prefilter(pattern), static_cast<uint32_t>(pattern.get_size()) };
+		// only the positions with the anchor bytes are worth running the whole pattern against
+		for (cursor.start(range); !cursor.exhausted(); cursor.advance()) {
+			Match match;
+			if (match_pattern_at(pattern, range, cursor.next, match, counters))
+			{
+				instances.push_back(match);
+
+				if (max_count != 0 && instances.size() >= max_count) {
+					add_stats(counters);
+					return true;
+				}
+			}
+		}
+
+		add_stats(counters);
+		return false;
+	}
+
+	/*
+		Every absolute pointer in a relocatable image has a relocation, so a pattern with a pointer into rdata can only match
+		where the relocations say there is one
+	*/
+	template <typename Pattern>
+	bool find_pattern_from_relocations(std::vector<Match>& instances, const Segment& range, const Pattern& pattern, size_t pointer_offset, size_t max_count) const
+	{
+		ScanCounters counters("relocations", range.address, range.size, pattern.get_element_count());
+		const auto& sites = get_relocation_sites();
+		const image_address first_site = range.address + pointer_offset;
+		for (auto site = std::lower_bound(sites.begin(), sites.end(), first_site); site != sites.end() && *site - first_site < range.size; site++) {
+			const image_address address = *site - pointer_offset;
+
+			Match match;
+			if (match_pattern_at(pattern, range, range.data + (address - range.address), match, counters))
+			{
+				instances.push_back(match);
+
+				if (max_count != 0 && instances.size() >= max_count) {
+					add_stats(counters);
+					return true;
 				}
 			}
 		}
+		add_stats(counters);
+		return false;
+	}
+
+	template <typename Pattern>
+	bool find_pattern_from_call_sites(std::vector<Match>& instances, const Pattern& pattern, size_t call_offset, image_address call_target, size_t max_count) const
+	{
+		// the callers are spread over all the code, so there is no one range to report
+		ScanCounters counters("call sites", 0, 0, pattern.get_element_count());
+		const auto call_sites = find_call_sites(call_target);
+		for (const CallSite* call_site = call_sites.first; call_site != call_sites.second; call_site++) {
+			const image_address address = module_base + call_site->address - call_offset;
+			const Segment* segment = find_segment(code, address);
+			if (!segment)
+				continue;
+
+			Match match;
+			if (match_pattern_at(pattern, *segment, segment->data + (address - segment->address), match, counters))
+			{
+				instances.push_back(match);
 
+				if (max_count != 0 && instances.size() >= max_count) {
+					add_stats(counters);
+					return true;
+				}
+			}
+		}
+		add_stats(counters);
 		return false;
 	}
 
-	static bool in_range_list(const range_list& list, const uint8_t* pointer) {
-		for (auto range : list) {
-			if (in_range(pointer, range.first, range.second))
-				return true;
+	/*
+		Finds the matches for `pattern` from the call sites or relocations if it has a call or an unanchored rdata pointer,
+		returns false if it has neither and has to be scanned for
+	*/
+	template <typename Pattern>
+	bool find_pattern_without_scanning(std::vector<Match>& instances, const range_list& ranges, bool use_call_sites, const Pattern& pattern, size_t max_count) const
+	{
+		size_t element_offset;
+		image_address call_target;
+		if (use_call_sites && pattern.find_call_element(element_offset, call_target) && use_call_index()) {
+			find_pattern_from_call_sites(instances, pattern, element_offset, call_target, max_count);
+			return true;
+		}
+		if (relocation_blocks_size != 0 && pattern.find_unanchored_rdata_pointer(element_offset)) {
+			for (const auto& range : ranges) {
+				if (find_pattern_from_relocations(instances, range, pattern, element_offset, max_count))
+					break;
+			}
+			return true;
 		}
 		return false;
 	}
 
-	static bool in_range(const uint8_t* pointer, const size_t base, const size_t size) {
-		size_t offset = reinterpret_cast<size_t>(pointer);
-		return offset >= base && offset < (base + size);
+	template <typename Pattern>
+	bool try_search_at(const PatternSearch<Pattern>& search, std::vector<Match>& instances, CandidateCursor& cursor, const Segment& range, ScanCounters& counters) const
+	{
+		const uint8_t* data = cursor.next;
+		cursor.advance();
+
+		Match match;
+		if (!match_pattern_at(search.pattern, range, data, match, counters))
+			return false;
+
+		instances.push_back(match);
+		// this pattern has all the matches we want
+		cursor.done = search.max_count != 0 && instances.size() >= search.max_count;
+		if (cursor.done)
+			cursor.next = cursor.last;
+		return cursor.done;
+	}
+
+	template <typename... Patterns, size_t... indexes>
+	void find_patterns_in_ranges_internal(const range_list& ranges, bool use_call_sites, std::array<std::vector<Match>, sizeof...(Patterns)>& results,
+		std::index_sequence<indexes...>, const PatternSearch<Patterns>&... searches) const
+	{
+		std::array<CandidateCursor, sizeof...(Patterns)> cursors = { CandidateCursor{ build_prefilter(searches.pattern), static_cast<uint32_t>(searches.pattern.get_size()) }... };
+		// the patterns that can be looked up don't take part in the walk
+		((cursors[indexes].done = find_pattern_without_scanning(results[indexes], ranges, use_call_sites, searches.pattern, searches.max_count)), ...);
+
+		// number of patterns that can still produce matches
+		size_t patterns_active = 0;
+		for (const auto& cursor : cursors)
+			patterns_active += !cursor.done;
+		if (patterns_active == 0)
+			return;
+
+		for (const auto& range : ranges) {
+			const std::array<bool, sizeof...(Patterns)> walked = { !cursors[indexes].done... };
+			for (auto& cursor : cursors)
+				cursor.start(range);
+			// the patterns share the walk over the range, so they are all given the time for the whole range
+			std::array<ScanCounters, sizeof...(Patterns)> counters = { ScanCounters("multi-pattern scan", range.address, range.size, searches.pattern.get_element_count())... };
+
+			while (true) {
+				// step through the candidates of all the patterns in address order, so the data is only walked once
+				const uint8_t* address = nullptr;
+				for (const auto& cursor : cursors) {
+					if (!cursor.exhausted() && (!address || cursor.next < address))
+						address = cursor.next;
+				}
+				if (!address)
+					break;
+
+				patterns_active -= (size_t(!cursors[indexes].exhausted() && cursors[indexes].next == address
+					&& try_search_at(searches, results[indexes], cursors[indexes], range, counters[indexes])) + ...);
+				if (patterns_active == 0)
+					break;
+			}
+
+			for (size_t i = 0; i < counters.size(); i++) {
+				if (walked[i])
+					add_stats(counters[i]);
+			}
+			if (patterns_active == 0)
+				return;
+		}
+	}
+
+	template <typename... Patterns>
+	std::array<std::vector<Match>, sizeof...(Patterns)> find_patterns_in_ranges(const range_list& ranges, bool use_call_sites, const PatternSearch<Patterns>&... searches) const
+	{
+		std::array<std::vector<Match>, sizeof...(Patterns)> results;
+		find_patterns_in_ranges_internal(ranges, use_call_sites, results, std::index_sequence_for<Patterns...>{}, search(searches.pattern.resolve(*this), searches.max_count)...);
+		return results;
+	}
+
+	/*
+		Builds the code/data/rdata lists from the section table, sorted by address with neighbouring sections merged
+	*/
+	void load_sections(const PEImage& image);
+
+	/*
+		Finds the segment in `list` containing `address` using the page table
+	*/
+	const Segment* find_segment(const range_list& list, image_address address) const {
+		const image_address page = (address - module_base) >> page_shift;
+		if (page >= page_table.size() || page_table[page] == page_unmapped)
+			return nullptr;
+		if (page_table[page] == page_shared)
+			return find_segment_linear(list, address);
+
+		const PageOwner& owner = page_owners[page_table[page] - 1];
+		return owner.list == &list && owner.segment->contains(address) ? owner.segment : nullptr;
+	}
+
+	/*
+		Same as above but for a segment of any kind
+	*/
+	const Segment* find_segment(image_address address) const {
+		const image_address page = (address - module_base) >> page_shift;
+		if (page >= page_table.size() || page_table[page] == page_unmapped)
+			return nullptr;
+		if (page_table[page] == page_shared) {
+			for (const range_list* ranges : { &code, &data, &rdata }) {
+				if (const Segment* segment = find_segment_linear(*ranges, address))
+					return segment;
+			}
+			return nullptr;
+		}
+
+		const Segment* segment = page_owners[page_table[page] - 1].segment;
+		return segment->contains(address) ? segment : nullptr;
+	}
+
+	static const Segment* find_segment_linear(const range_list& list, image_address address) {
+		for (const auto& range : list) {
+			if (range.contains(address))
+				return &range;
+		}
+		return nullptr;
 	}
 
 	range_list code;
 	range_list data;
 	range_list rdata;
-	size_t module_base;
-	size_t module_size;
-};
+	image_address module_base;
+	uint32_t module_size;
+	ModuleIdentity identity;
+	bool is_64bit = false;
 
-class PatternEntryByte : public PatternEntryBase
-{
-public:
-	PatternEntryByte(uint8_t value):
-		char_value(value)
-	{}
+	/*
+		One entry per page of the module, either the index + 1 of the only segment on that page in `page_owners`,
+		unmapped or shared if more than one segment is on it (those pages fall back to a linear search)
+	*/
+	static constexpr uint32_t page_shift = 12;
+	static constexpr uint8_t page_unmapped = 0;
+	static constexpr uint8_t page_shared = 0xFF;
+
+	struct PageOwner
+	{
+		const range_list* list;
+		const Segment* segment;
+	};
+	std::vector<PageOwner> page_owners;
+	std::vector<uint8_t> page_table;
 
-	size_t entry_size() const {
-		return 1;
+	void build_relocation_index() const;
+
+	/*
+		Adds `counters` to the stats under the current label, chunks of a segment are reported as the whole segment
+	*/
+	void add_stats(ScanCounters& counters) const {
+#if PATTERN_SCANNER_STATS
+		if (const Segment* segment = find_segment(counters.range_address)) {
+			counters.range_address = segment->address;
+			counters.range_size = segment->size;
+		}
+		stats.add(stats_label, counters);
+#endif
 	}
 
-	bool matches(const PatternScanner& scanner, const uint8_t* data) const {
-		return *data == char_value;
+#if PATTERN_SCANNER_STATS
+	mutable ScanStats stats;
+	mutable const char* stats_label = "unlabelled";
+#endif
+
+	const uint8_t* relocation_blocks = nullptr;
+	uint32_t relocation_blocks_size = 0;
+	mutable std::once_flag relocation_index_built;
+	mutable std::vector<image_address> relocation_sites;
+
+	/*
+		Stored relative to the module base, which keeps the index small
+	*/
+	struct CallSite
+	{
+		uint32_t target;
+		uint32_t address;
+
+		bool operator<(const CallSite& other) const {
+			return target < other.target || (target == other.target && address < other.address);
+		}
+	};
+
+	mutable std::once_flag call_index_built;
+	// sorted by target then call address
+	mutable std::vector<CallSite> call_index;
+	mutable std::atomic<uint32_t> call_target_lookups{ 0 };
+
+	/*
+		Returns the calls to `target` from the call index, building it first if needed
+	*/
+	std::pair<const CallSite*, const CallSite*> find_call_sites(image_address target) const;
+
+	/*
+		Building the index reads every E8 byte in the code, which costs several prefiltered scans, so a pattern with a call
+		is scanned for until a second one is looked up. Returns true if the caller should use the call index.
+	*/
+	bool use_call_index() const {
+		return call_target_lookups.fetch_add(1, std::memory_order_relaxed) != 0;
 	}
 
-private:
-	uint8_t char_value;
+	bool instruction_boundaries_only = false;
+
+	/*
+		The instruction start bitmap of a code segment, swept a block at a time. Each block starts the sweep
+		`instruction_block_lead_in` bytes early so it has fallen into step with the instructions by the block.
+	*/
+	static constexpr size_t instruction_block_size = 0x1000;
+	static constexpr size_t instruction_block_lead_in = 0x40;
+	static constexpr uint8_t block_not_swept = 0;
+	static constexpr uint8_t block_being_written = 1;
+	static constexpr uint8_t block_swept = 2;
+
+	struct InstructionStarts
+	{
+		std::vector<uint64_t> bitmap;
+		std::unique_ptr<std::atomic<uint8_t>[]> block_state;
+	};
+
+	mutable std::once_flag instruction_starts_built;
+	// one per code segment, in the same order as `code`
+	mutable std::vector<InstructionStarts> instruction_starts;
+
+	/*
+		Returns the instruction start bitmaps, allocating them (without sweeping anything) the first time
+	*/
+	std::vector<InstructionStarts>& get_instruction_starts() const;
+
+	/*
+		Sweeps the block of `segment` holding `offset` and returns if an instruction starts there.
+		The result is only stored if no other thread is storing the same block.
+	*/
+	bool sweep_instruction_block(const Segment& segment, InstructionStarts& starts, size_t block, size_t offset) const;
+
+	mutable std::mutex string_index_lock;
+	mutable std::unordered_map<std::string, std::vector<image_address>> string_index;
 };
 
-class PatternEntryCall : public PatternEntryBase
+/*
+	Finds the matches as it's iterated, each step resumes the scan where the last match was found.
+	Iterating doesn't allocate, but the iterators all share the range's position so it can only be walked once.
+*/
+template <typename Pattern>
+class PatternScanner::MatchRange
 {
 public:
-	PatternEntryCall(uint32_t value) :
-		call_target(value)
-	{}
+	class iterator
+	{
+	public:
+		typedef std::input_iterator_tag iterator_category;
+		typedef Match value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const Match* pointer;
+		typedef const Match& reference;
+
+		explicit iterator(MatchRange* matches) :
+			matches(matches && matches->current ? matches : nullptr)
+		{}
+
+		const Match& operator*() const {
+			return *matches->current;
+		}
+
+		const Match* operator->() const {
+			return &*matches->current;
+		}
+
+		iterator& operator++() {
+			matches->advance();
+			if (!matches->current)
+				matches = nullptr;
+			return *this;
+		}
+
+		bool operator==(const iterator& other) const {
+			return matches == other.matches;
+		}
+
+		bool operator!=(const iterator& other) const {
+			return matches != other.matches;
+		}
+
+	private:
+		MatchRange* matches;
+	};
 
-	size_t entry_size() const {
-		return 5;
+	MatchRange(const PatternScanner& scanner, const Pattern& pattern, const range_list& ranges, bool use_call_sites) :
+		scanner(scanner),
+		pattern(pattern.resolve(scanner)),
+		ranges(ranges),
+		counters("scan", 0, 0, 0)
+	{
+		image_address call_target;
+		// only the callers of the target can match, so look them up instead of scanning once the index is worth building
+		if (use_call_sites && this->pattern.find_call_element(element_offset, call_target) && scanner.use_call_index()) {
+			source = Source::call_sites;
+			std::tie(next_call_site, last_call_site) = scanner.find_call_sites(call_target);
+			counters = ScanCounters("call sites", 0, 0, this->pattern.get_element_count());
+		}
+		// without an anchor in the pointer the prefilter would check nearly every position
+		else if (scanner.relocation_blocks_size != 0 && this->pattern.find_unanchored_rdata_pointer(element_offset)) {
+			source = Source::relocations;
+		}
+		else {
+			source = Source::scan;
+			cursor = { PatternScanner::build_prefilter(this->pattern), static_cast<uint32_t>(this->pattern.get_size()) };
+		}
+
+		if (source != Source::call_sites && !ranges.empty())
+			start_range();
+		advance();
 	}
 
-	bool matches(const PatternScanner& scanner, const uint8_t* data) const {
-		if (*data != 0xE8)
-			return false;
-		return *reinterpret_cast<const uint32_t*>(&data[1]) == call_target - (reinterpret_cast<const uint32_t>(data) + 5);
+	MatchRange(const MatchRange&) = delete;
+	MatchRange& operator=(const MatchRange&) = delete;
+
+	~MatchRange()
+	{
+		// the caller stopped before the end
+		if (current)
+			scanner.add_stats(counters);
+	}
+
+	iterator begin() {
+		return iterator(this);
+	}
+
+	iterator end() {
+		return iterator(nullptr);
 	}
 
 private:
-	uint32_t call_target;
-};
+	typedef decltype(std::declval<const Pattern&>().resolve(std::declval<const PatternScanner&>())) ResolvedPattern;
 
-template <size_t size>
-class PatternEntryBytes : public PatternEntryBase
-{
-public:
-	PatternEntryBytes(const std::array<uint8_t, size> &_values) :
-		values(_values)
-	{}
+	enum class Source
+	{
+		call_sites,
+		relocations,
+		scan
+	};
 
-	size_t entry_size() const {
-		return size;
+	void start_range() {
+		const Segment& range = ranges[range_index];
+		if (source == Source::relocations) {
+			const auto& sites = scanner.get_relocation_sites();
+			first_site = range.address + element_offset;
+			next_site = sites.data() + (std::lower_bound(sites.begin(), sites.end(), first_site) - sites.begin());
+			last_site = sites.data() + sites.size();
+			counters = ScanCounters("relocations", range.address, range.size, pattern.get_element_count());
+		}
+		else {
+			cursor.start(range);
+			counters = ScanCounters("scan", range.address, range.size, pattern.get_element_count());
+		}
 	}
 
-	bool matches(const PatternScanner& scanner, const uint8_t* data) const {
-		return memcmp(data, values.data(), values.size()) == 0;
+	/*
+		Moves `current` to the next match, or empties it once there are none left
+	*/
+	void advance() {
+		Match match;
+		if (source == Source::call_sites) {
+			while (next_call_site != last_call_site) {
+				const image_address address = scanner.module_base + (next_call_site++)->address - element_offset;
+				const Segment* segment = scanner.find_segment(scanner.code, address);
+				if (segment && scanner.match_pattern_at(pattern, *segment, segment->data + (address - segment->address), match, counters)) {
+					current = match;
+					return;
+				}
+			}
+			finish();
+			return;
+		}
+
+		while (range_index < ranges.size()) {
+			const Segment& range = ranges[range_index];
+			if (source == Source::relocations) {
+				while (next_site != last_site && *next_site - first_site < range.size) {
+					const image_address address = *next_site++ - element_offset;
+					if (scanner.match_pattern_at(pattern, range, range.data + (address - range.address), match, counters)) {
+						current = match;
+						return;
+					}
+				}
+			}
+			else {
+				while (!cursor.exhausted()) {
+					const uint8_t* data = cursor.next;
+					cursor.advance();
+					if (scanner.match_pattern_at(pattern, range, data, match, counters)) {
+						current = match;
+						return;
+					}
+				}
+			}
+
+			scanner.add_stats(counters);
+			if (++range_index < ranges.size())
+				start_range();
+		}
+		current.reset();
 	}
 
-private:
-	std::array<uint8_t, size> values;
+	void finish() {
+		scanner.add_stats(counters);
+		current.reset();
+	}
+
+	const PatternScanner& scanner;
+	const ResolvedPattern pattern;
+	const range_list& ranges;
+	Source source;
+	// offset of the call or the pointer the matches are looked up from
+	size_t element_offset = 0;
+
+	const CallSite* next_call_site = nullptr;
+	const CallSite* last_call_site = nullptr;
+
+	size_t range_index = 0;
+	image_address first_site = 0;
+	const image_address* next_site = nullptr;
+	const image_address* last_site = nullptr;
+	CandidateCursor cursor = {};
+
+	ScanCounters counters;
+	std::optional<Match> current;
 };
 
-template<typename T>
-inline static std::unique_ptr<PatternEntryBytes<sizeof(T)>> pattern_entry_bytes_from_pod(const T value)
+/*
+	Pattern elements, each has a fixed `size` and a `matches` check the compiler can inline into the pattern.
+	`for_each_literal` reports the bytes that are always the same for a match.
+*/
+namespace PatternElement
 {
-	static_assert(std::is_pod_v<T>);
+	struct Byte
+	{
+		static constexpr size_t size = 1;
+		uint8_t value;
+
+		bool matches(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+			return *data == value;
+		}
+
+		template <typename Callback>
+		void for_each_literal(Callback&& callback) const {
+			callback(0, value);
+		}
+	};
+
+	template <size_t count>
+	struct Bytes
+	{
+		static constexpr size_t size = count;
+		std::array<uint8_t, count> values;
+
+		bool matches(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+			return memcmp(data, values.data(), values.size()) == 0;
+		}
+
+		template <typename Callback>
+		void for_each_literal(Callback&& callback) const {
+			for (size_t i = 0; i < count; i++)
+				callback(i, values[i]);
+		}
+	};
+
+	/*
+		Matches the in-memory representation of a POD value
+	*/
+	template <typename T>
+	struct Value
+	{
+		static_assert(std::is_pod_v<T>);
+		static constexpr size_t size = sizeof(T);
+		T value;
+
+		bool matches(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+			return memcmp(data, &value, sizeof(T)) == 0;
+		}
+
+		template <typename Callback>
+		void for_each_literal(Callback&& callback) const {
+			uint8_t bytes[sizeof(T)];
+			memcpy(bytes, &value, sizeof(T));
+			for (size_t i = 0; i < sizeof(T); i++)
+				callback(i, bytes[i]);
+		}
+	};
+
+	template <size_t count = 1>
+	struct Any
+	{
+		static constexpr size_t size = count;
+
+		bool matches(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+			return true;
+		}
+
+		template <typename Callback>
+		void for_each_literal(Callback&& callback) const {}
+	};
+
+	/*
+		A `call rel32` (E8) or `jmp rel32` (E9) to `target`, the same encoding on x86 and x64
+	*/
+	template <uint8_t opcode>
+	struct RelativeBranch
+	{
+		static constexpr size_t size = 5;
+		image_address target;
+
+		bool matches(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+			if (*data != opcode)
+				return false;
+			int32_t displacement;
+			memcpy(&displacement, &data[1], sizeof(displacement));
+			return address + 5 + displacement == target;
+		}
+
+		template <typename Callback>
+		void for_each_literal(Callback&& callback) const {
+			// only the opcode is fixed, the displacement depends on where the call is
+			callback(0, opcode);
+		}
+	};
 
-	std::array<uint8_t, sizeof(T)> pattern_as_array;
-	std::memcpy(pattern_as_array.data(), &value, sizeof(T));
+	typedef RelativeBranch<0xE8> Call;
+	typedef RelativeBranch<0xE9> Jump;
 
-	return std::make_unique<PatternEntryBytes<sizeof(T)>>(pattern_as_array);
+	struct StringXREF
+	{
+		// absolute address in the image, not a pointer on the machine doing the scanning
+		static constexpr size_t size = sizeof(uint32_t);
+		const char* string;
+
+		bool matches(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+			return scanner.is_string_at(*reinterpret_cast<const uint32_t*>(data), string);
+		}
+
+		template <typename Callback>
+		void for_each_literal(Callback&& callback) const {}
+
+		/*
+			The same check with the addresses of the string looked up before scanning, so it's just an integer compare
+		*/
+		struct Resolved
+		{
+			static constexpr size_t size = sizeof(uint32_t);
+			static constexpr size_t max_addresses = 4;
+			const char* string;
+			// only the copies a 32-bit pointer can reach
+			std::array<uint32_t, max_addresses> addresses;
+			// if there are more copies than fit in `addresses` the string is compared instead
+			size_t address_count;
+
+			bool matches(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+				const uint32_t pointer = *reinterpret_cast<const uint32_t*>(data);
+				if (address_count > max_addresses)
+					return scanner.is_string_at(pointer, string);
+				for (size_t i = 0; i < address_count; i++) {
+					if (addresses[i] == pointer)
+						return true;
+				}
+				return false;
+			}
+
+			template <typename Callback>
+			void for_each_literal(Callback&& callback) const {
+				// with only one copy of the string the reference is a fixed value, which makes a good anchor
+				if (address_count != 1)
+					return;
+				uint8_t bytes[sizeof(uint32_t)];
+				memcpy(bytes, &addresses[0], sizeof(bytes));
+				for (size_t i = 0; i < sizeof(bytes); i++)
+					callback(i, bytes[i]);
+			}
+		};
+	};
+
+	/*
+		The disp32 of a RIP-relative operand pointing at a copy of the string in rdata, e.g. in `lea rcx, [rip+disp32]` on x64.
+		It's relative to the end of the instruction, so this only works when the displacement is the last field (no immediate after it).
+	*/
+	struct RipRelativeStringXREF
+	{
+		static constexpr size_t size = sizeof(int32_t);
+		const char* string;
+
+		static image_address get_target(const uint8_t* data, image_address address) {
+			int32_t displacement;
+			memcpy(&displacement, data, sizeof(displacement));
+			return address + size + displacement;
+		}
+
+		bool matches(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+			return scanner.is_string_at(get_target(data, address), string);
+		}
+
+		template <typename Callback>
+		void for_each_literal(Callback&& callback) const {}
+
+		/*
+			The same check against the addresses of the string looked up before scanning
+		*/
+		struct Resolved
+		{
+			static constexpr size_t size = sizeof(int32_t);
+			static constexpr size_t max_addresses = 4;
+			const char* string;
+			std::array<image_address, max_addresses> addresses;
+			// if there are more copies than fit in `addresses` the string is compared instead
+			size_t address_count;
+
+			bool matches(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+				const image_address target = get_target(data, address);
+				if (address_count > max_addresses)
+					return scanner.is_string_at(target, string);
+				for (size_t i = 0; i < address_count; i++) {
+					if (addresses[i] == target)
+						return true;
+				}
+				return false;
+			}
+
+			// the displacement changes with the position, so there is never a fixed value
+			template <typename Callback>
+			void for_each_literal(Callback&& callback) const {}
+		};
+	};
+
+	template <typename T = int>
+	struct IntegerRange
+	{
+		static constexpr size_t size = sizeof(T);
+		T lower_bound;
+		T upper_bound;
+
+		bool matches(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+			const T value = *reinterpret_cast<const T*>(data);
+			return lower_bound <= value && value <= upper_bound;
+		}
+
+		template <typename Callback>
+		void for_each_literal(Callback&& callback) const {}
+	};
 }
 
-class PatternEntryAny : public PatternEntryBase
+namespace PatternElement
 {
-public:
-	PatternEntryAny(size_t _size = 1):
-		size(_size)
-	{}
+	/*
+		Look up anything an element needs from the scanner before scanning, most elements don't need anything
+	*/
+	template <typename Element>
+	Element resolve_element(const Element& element, const PatternScanner& scanner) {
+		return element;
+	}
+
+	template <typename Element>
+	bool element_call_target(const Element& element, image_address& target) {
+		return false;
+	}
 
-	bool matches(const PatternScanner& scanner, const uint8_t* data) const {
+	inline bool element_call_target(const Call& element, image_address& target) {
+		target = element.target;
 		return true;
 	}
 
-	size_t entry_size() const {
-		return size;
+	/*
+		Absolute pointers into rdata that don't give the prefilter any literal bytes
+	*/
+	template <typename Element>
+	bool is_unanchored_rdata_pointer(const Element& element) {
+		return false;
 	}
 
-private:
-	size_t size;
-};
+	inline bool is_unanchored_rdata_pointer(const StringXREF& element) {
+		return true;
+	}
+
+	inline bool is_unanchored_rdata_pointer(const StringXREF::Resolved& element) {
+		return element.address_count != 1;
+	}
 
-class PatternEntryStringXREF : public PatternEntryBase
+	inline StringXREF::Resolved resolve_element(const StringXREF& element, const PatternScanner& scanner) {
+		StringXREF::Resolved resolved = { element.string, {}, 0 };
+		for (image_address address : scanner.find_string_addresses(element.string)) {
+			if (address > UINT32_MAX)
+				continue;
+			if (resolved.address_count < resolved.addresses.size())
+				resolved.addresses[resolved.address_count] = static_cast<uint32_t>(address);
+			resolved.address_count++;
+		}
+		return resolved;
+	}
+
+	inline RipRelativeStringXREF::Resolved resolve_element(const RipRelativeStringXREF& element, const PatternScanner& scanner) {
+		RipRelativeStringXREF::Resolved resolved = { element.string, {}, 0 };
+		const auto& addresses = scanner.find_string_addresses(element.string);
+		resolved.address_count = addresses.size();
+		for (size_t i = 0; i < std::min(addresses.size(), resolved.addresses.size()); i++)
+			resolved.addresses[i] = addresses[i];
+		return resolved;
+	}
+}
+
+template <size_t... sizes>
+constexpr std::array<size_t, sizeof...(sizes)> pattern_element_offsets()
+{
+	std::array<size_t, sizeof...(sizes)> offsets = {};
+	const size_t element_sizes[] = { sizes..., 0 };
+	size_t offset = 0;
+	for (size_t i = 0; i < sizeof...(sizes); i++) {
+		offsets[i] = offset;
+		offset += element_sizes[i];
+	}
+	return offsets;
+}
+
+template <typename... Elements>
+class Pattern;
+
+template <typename... Elements>
+constexpr Pattern<Elements...> make_pattern(Elements... elements);
+
+/*
+	A sequence of pattern elements, matched back to back
+*/
+template <typename... Elements>
+class Pattern
 {
 public:
-	PatternEntryStringXREF(const char* _string) :
-		string(_string)
+	static constexpr size_t size = (Elements::size + ... + 0);
+	static constexpr size_t element_count = sizeof...(Elements);
+
+	constexpr Pattern(Elements... elements) :
+		elements(elements...)
 	{}
 
-	bool matches(const PatternScanner& scanner, const uint8_t* data) const {
-		const uint8_t* pointer = *reinterpret_cast<const uint8_t* const*>(data);
+	/*
+		Same as `size`, for code that also takes patterns whose size is only known at runtime
+	*/
+	constexpr size_t get_size() const {
+		return size;
+	}
 
-		if (scanner.is_in_rdata_segment(pointer))
-		{
-			return strcmp(reinterpret_cast<const char*>(pointer), string) == 0;
-		}
-		return false;
+	constexpr size_t get_element_count() const {
+		return element_count;
 	}
 
-	size_t entry_size() const {
-		return sizeof(string);
+	bool matches(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+		return matches_internal(scanner, data, address, std::index_sequence_for<Elements...>{});
 	}
-private:
-	const char* string;
-};
 
-template<typename T = int>
-class PatternEntryIntegerRange : public PatternEntryBase
-{
-public:
-	PatternEntryIntegerRange(T lower, T upper) :
-		lower_bound(lower),
-		upper_bound(upper)
-	{
+	/*
+		Returns the index of the first element that doesn't match, or the element count if they all do
+	*/
+	size_t find_rejecting_element(const PatternScanner& scanner, const uint8_t* data, image_address address) const {
+		return find_rejecting_element_internal(scanner, data, address, std::index_sequence_for<Elements...>{});
+	}
+
+	template <typename Callback>
+	void for_each_literal(Callback&& callback) const {
+		for_each_literal_internal(callback, std::index_sequence_for<Elements...>{});
 	}
 
-	bool matches(const PatternScanner& scanner, const uint8_t* data) const {
-		const T value = *reinterpret_cast<const T*>(data);
-		return lower_bound <= value && value <= upper_bound;
+	/*
+		Finds the first call element, matches can then only be at the call sites of its target
+	*/
+	bool find_call_element(size_t& offset, image_address& target) const {
+		return find_call_element_internal(offset, target, std::index_sequence_for<Elements...>{});
 	}
 
-	size_t entry_size() const {
-		return sizeof(T);
+	/*
+		Finds the first element holding an absolute address in rdata that isn't a literal, the relocations list where those can be
+	*/
+	bool find_unanchored_rdata_pointer(size_t& offset) const {
+		return find_unanchored_rdata_pointer_internal(offset, std::index_sequence_for<Elements...>{});
 	}
+
+	/*
+		Returns a copy of this pattern with the elements resolved against `scanner`
+	*/
+	auto resolve(const PatternScanner& scanner) const {
+		return resolve_internal(scanner, std::index_sequence_for<Elements...>{});
+	}
+
 private:
-	const T lower_bound;
-	const T upper_bound;
+	static constexpr std::array<size_t, sizeof...(Elements)> offsets = pattern_element_offsets<Elements::size...>();
+
+	template <size_t... indexes>
+	bool matches_internal(const PatternScanner& scanner, const uint8_t* data, image_address address, std::index_sequence<indexes...>) const {
+		return (std::get<indexes>(elements).matches(scanner, data + offsets[indexes], address + offsets[indexes]) && ...);
+	}
+
+	template <size_t... indexes>
+	size_t find_rejecting_element_internal(const PatternScanner& scanner, const uint8_t* data, image_address address, std::index_sequence<indexes...>) const {
+		size_t rejecting_element = element_count;
+		((std::get<indexes>(elements).matches(scanner, data + offsets[indexes], address + offsets[indexes]) || (rejecting_element = indexes, false)) && ...);
+		return rejecting_element;
+	}
+
+	template <size_t... indexes>
+	bool find_call_element_internal(size_t& offset, image_address& target, std::index_sequence<indexes...>) const {
+		return ((PatternElement::element_call_target(std::get<indexes>(elements), target) && (offset = offsets[indexes], true)) || ...);
+	}
+
+	template <size_t... indexes>
+	bool find_unanchored_rdata_pointer_internal(size_t& offset, std::index_sequence<indexes...>) const {
+		return ((PatternElement::is_unanchored_rdata_pointer(std::get<indexes>(elements)) && (offset = offsets[indexes], true)) || ...);
+	}
+
+	template <size_t... indexes>
+	auto resolve_internal(const PatternScanner& scanner, std::index_sequence<indexes...>) const {
+		return make_pattern(PatternElement::resolve_element(std::get<indexes>(elements), scanner)...);
+	}
+
+	template <typename Callback, size_t... indexes>
+	void for_each_literal_internal(Callback& callback, std::index_sequence<indexes...>) const {
+		(std::get<indexes>(elements).for_each_literal([&callback](size_t offset, uint8_t value) {
+			callback(offsets[indexes] + offset, value);
+		}), ...);
+	}
+
+	std::tuple<Elements...> elements;
 };
 
+template <typename... Elements>
+constexpr Pattern<Elements...> make_pattern(Elements... elements)
+{
+	return Pattern<Elements...>(elements...);
+}
+
 #define PAT_BYTES(size, ...) \
-	PAT_UNI(PatternEntryBytes<size>, ##__VA_ARGS__)
+	PatternElement::Bytes<size>{ __VA_ARGS__ }
 #define PAT_ANY(size) \
-	PAT_UNI(PatternEntryAny, size)
+	PatternElement::Any<size>{}
 #define PAT_BYTE(byte) \
-	PAT_UNI(PatternEntryByte, byte)
+	PatternElement::Byte{ byte }
 #define PAT_CALL(call_target) \
-	PAT_UNI(PatternEntryCall, call_target)
+	PatternElement::Call{ call_target }
+#define PAT_JUMP(jump_target) \
+	PatternElement::Jump{ jump_target }
 #define PAT_STRING_XREF(string) \
-	PAT_UNI(PatternEntryStringXREF, string)
+	PatternElement::StringXREF{ string }
 #define PAT_POD_TYPE(pod) \
-	pattern_entry_bytes_from_pod(pod)
+	PatternElement::Value<decltype(pod)>{ pod }
 #define PAT_INTEGER_RANGE(type, lower, upper) \
-	PAT_UNI(PatternEntryIntegerRange<type>, lower, upper)
+	PatternElement::IntegerRange<type>{ lower, upper }
+
+#define PAT_RIP_STRING_XREF(string) \
+	PatternElement::RipRelativeStringXREF{ string }
 
 #define PAT_PUSH_STRING_XREF(string) \
 	PAT_BYTE(0x68), \
 	PAT_STRING_XREF(string)
-
@@ -0,0 +1,134 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#pragma once
+#include "PatternScanner.h"
+#include "KeyValueConfig.h"
+#include <cstdlib>
+
+/*
+	Remembers where patterns matched in a module, keyed on the module identity, so later runs don't need to rescan.
+	Offsets are stored relative to the module base and cached matches are checked again before they are used.
+	Each entry is keyed on a hash of the pattern as well as its name, so editing a signature doesn't pick up the old matches.
+*/
+class ScanCache
+{
+public:
+	ScanCache(const PatternScanner& scanner, std::filesystem::path path) :
+		scanner(scanner),
+		cache_file(path)
+	{
+		const auto& identity = scanner.get_module_identity();
+		is_valid = cache_file.exists("module_timestamp")
+			&& cache_file.getNumber<uint32_t>("module_timestamp", 0) == identity.timestamp
+			&& cache_file.getNumber<uint32_t>("module_checksum", 0) == identity.checksum
+			&& cache_file.getNumber<uint32_t>("module_image_size", 0) == identity.image_size;
+		if (!is_valid) {
+			LOG_INFO("Scan cache is missing or for a different executable, rescanning");
+			// nothing in it is any use for this executable
+			cache_file.clear();
+		}
+	}
+
+	~ScanCache()
+	{
+		if (!is_valid) {
+			const auto& identity = scanner.get_module_identity();
+			cache_file.setString("module_timestamp", to_hex(identity.timestamp));
+			cache_file.setString("module_checksum", to_hex(identity.checksum));
+			cache_file.setString("module_image_size", to_hex(identity.image_size));
+		}
+		cache_file.Save();
+	}
+
+	/*
+		Returns the cached matches for `name` if there are any and they all still match `pattern`.
+		Misses are never cached, so nothing is returned for an entry without matches either.
+	*/
+	template <typename Pattern>
+	std::optional<std::vector<PatternScanner::Match>> lookup(const std::string& name, const Pattern& pattern)
+	{
+		std::string value;
+		if (!is_valid || !cache_file.getString(get_key(name, pattern), value) || value.empty())
+			return std::optional<std::vector<PatternScanner::Match>>{};
+
+		std::vector<PatternScanner::Match> matches;
+		const char* position = value.c_str();
+		while (*position != '\0') {
+			char* end;
+			const uint32_t rva = strtoul(position, &end, 16);
+			if (end == position)
+				break;
+
+			auto match = scanner.match_pattern_at_address(pattern, scanner.get_module_base() + rva);
+			if (!match) {
+				LOG_INFO("Cached match for %s at %x is stale, rescanning", name.c_str(), rva);
+				return std::optional<std::vector<PatternScanner::Match>>{};
+			}
+			matches.push_back(*match);
+
+			position = *end == ',' ? end + 1 : end;
+		}
+
+		return matches;
+	}
+
+	/*
+		Remembers where `pattern` matched, an empty list isn't stored so a pattern that wasn't found is scanned for again next time
+	*/
+	template <typename Pattern>
+	void store(const std::string& name, const Pattern& pattern, const std::vector<PatternScanner::Match>& matches)
+	{
+		if (matches.empty())
+			return;
+
+		std::string value;
+		for (const auto& match : matches) {
+			if (!value.empty())
+				value += ',';
+			value += to_hex(static_cast<uint32_t>(match.offset - scanner.get_module_base()));
+		}
+		cache_file.setString(get_key(name, pattern), value);
+	}
+
+private:
+	/*
+		`name_<hash>`, FNV-1a over the size, the element count and the fixed bytes of the resolved pattern
+	*/
+	template <typename Pattern>
+	std::string get_key(const std::string& name, const Pattern& pattern) const
+	{
+		const auto resolved = pattern.resolve(scanner);
+		uint32_t hash = 0x811C9DC5;
+		const auto add = [&hash](uint64_t value) {
+			for (size_t i = 0; i < sizeof(value); i++) {
+				hash ^= static_cast<uint8_t>(value >> (i * 8));
+				hash *= 0x01000193;
+			}
+		};
+		add(resolved.get_size());
+		add(resolved.get_element_count());
+		resolved.for_each_literal([&add](size_t offset, uint8_t value) {
+			add(offset);
+			add(value);
+		});
+
+		char buffer[0x10];
+		snprintf(buffer, sizeof(buffer), "_%08x", hash);
+		return name + buffer;
+	}
+
+	static std::string to_hex(uint32_t value)
+	{
+		char buffer[0x10];
+		snprintf(buffer, sizeof(buffer), "0x%x", value);
+		return buffer;
+	}
+
+	const PatternScanner& scanner;
+	KeyValueFile cache_file;
+	bool is_valid;
+};
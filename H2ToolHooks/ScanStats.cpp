@@ -0,0 +1,67 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#include "ScanStats.h"
+
+#if PATTERN_SCANNER_STATS
+#include "Debug.h"
+#include <algorithm>
+#include <cstring>
+
+void ScanStats::add(const char* label, ScanCounters& counters)
+{
+	counters.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - counters.start_time).count();
+
+	std::lock_guard<std::mutex> guard(lock);
+	auto pattern = std::find_if(patterns.begin(), patterns.end(), [label](const PatternTotals& totals) { return totals.label == label; });
+	if (pattern == patterns.end())
+		pattern = patterns.insert(patterns.end(), { label, {} });
+
+	for (auto& range : pattern->ranges) {
+		if (strcmp(range.method, counters.method) == 0 && range.range_address == counters.range_address
+			&& range.range_size == counters.range_size && range.rejections.size() == counters.rejections.size()) {
+			range.candidates += counters.candidates;
+			range.matches += counters.matches;
+			for (size_t i = 0; i < range.rejections.size(); i++)
+				range.rejections[i] += counters.rejections[i];
+			range.milliseconds += counters.milliseconds;
+			return;
+		}
+	}
+	pattern->ranges.push_back(counters);
+}
+
+void ScanStats::print() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	LOG_INFO("Scan summary, %zu patterns", patterns.size());
+	for (const auto& pattern : patterns) {
+		uint64_t bytes = 0, candidates = 0, matches = 0;
+		double milliseconds = 0;
+		for (const auto& range : pattern.ranges) {
+			bytes += range.range_size;
+			candidates += range.candidates;
+			matches += range.matches;
+			milliseconds += range.milliseconds;
+		}
+		LOG_INFO("  %s: %llu matches, %llu candidates, %llu bytes, %.3f ms", pattern.label.c_str(),
+			static_cast<unsigned long long>(matches), static_cast<unsigned long long>(candidates), static_cast<unsigned long long>(bytes), milliseconds);
+
+		for (const auto& range : pattern.ranges) {
+			// element index=rejection count, only for the elements that rejected anything
+			char rejections[0x200] = "";
+			size_t length = 0;
+			for (size_t i = 0; i < range.rejections.size() && length < sizeof(rejections); i++) {
+				if (range.rejections[i] != 0)
+					length += snprintf(rejections + length, sizeof(rejections) - length, " %zu=%llu", i, static_cast<unsigned long long>(range.rejections[i]));
+			}
+			LOG_INFO("    %s %llx+%x: %llu matches, %llu candidates, %.3f ms, rejected at element%s", range.method,
+				static_cast<unsigned long long>(range.range_address), range.range_size,
+				static_cast<unsigned long long>(range.matches), static_cast<unsigned long long>(range.candidates), range.milliseconds, length ? rejections : " (none)");
+		}
+	}
+}
+#endif
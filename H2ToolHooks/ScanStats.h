@@ -0,0 +1,100 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// on in debug builds, define PATTERN_SCANNER_STATS as 0 or 1 to override
+#ifndef PATTERN_SCANNER_STATS
+#ifdef _DEBUG
+#define PATTERN_SCANNER_STATS 1
+#else
+#define PATTERN_SCANNER_STATS 0
+#endif
+#endif
+
+#if PATTERN_SCANNER_STATS
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+	What one pattern search did in one range: the candidates the full pattern was run against,
+	which element turned each rejected one down, and how long it took
+*/
+class ScanCounters
+{
+public:
+	ScanCounters(const char* method, uint64_t range_address, uint32_t range_size, size_t element_count) :
+		method(method),
+		range_address(range_address),
+		range_size(range_size),
+		rejections(element_count, 0),
+		start_time(std::chrono::steady_clock::now())
+	{}
+
+	/*
+		Records the result of one candidate, `element` is the index of the element that didn't match or the element count for a match
+	*/
+	void add_candidate(size_t element) {
+		candidates++;
+		if (element < rejections.size())
+			rejections[element]++;
+		else
+			matches++;
+	}
+
+	const char* method;
+	uint64_t range_address;
+	uint32_t range_size;
+	uint64_t candidates = 0;
+	uint64_t matches = 0;
+	// by element index
+	std::vector<uint64_t> rejections;
+	std::chrono::steady_clock::time_point start_time;
+	double milliseconds = 0;
+};
+
+/*
+	Collects the counters from every search under the label they were made for, safe to add to from the parallel scan
+*/
+class ScanStats
+{
+public:
+	/*
+		Adds `counters` to the totals for `label`, counters for the same method and range are merged
+	*/
+	void add(const char* label, ScanCounters& counters);
+
+	/*
+		Prints a summary of every pattern and range searched, in the order they were first searched
+	*/
+	void print() const;
+
+private:
+	struct PatternTotals
+	{
+		std::string label;
+		std::vector<ScanCounters> ranges;
+	};
+
+	mutable std::mutex lock;
+	std::vector<PatternTotals> patterns;
+};
+#else
+/*
+	Stands in for the counters when they are compiled out, every call does nothing
+*/
+class ScanCounters
+{
+public:
+	ScanCounters(const char* method, uint64_t range_address, uint32_t range_size, size_t element_count) {}
+
+	void add_candidate(size_t element) {}
+};
+#endif
@@ -0,0 +1,103 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+#pragma once
+#include "PatternScanner.h"
+
+/*
+	Signatures for the H2 tool code and data we patch, shared with the offline scanner
+*/
+namespace Signatures
+{
+	constexpr auto hs_assert = make_pattern(
+		PAT_BYTES(2, {0x6A, 0x01}), // push    1 (is fatal)
+		PAT_BYTE(0x68), PAT_INTEGER_RANGE(uint32_t, 2960 - 400, 2960 + 400), // push c_line_number
+		PAT_BYTE(0x68), PAT_ANY(4), // push c_file_name
+		PAT_BYTE(0x68), PAT_STRING_XREF("hs_type_valid(definition->return_type)")
+	);
+
+	/*
+	* Assert sites, the call targets are found from hs_assert. With calls in the pattern it's matched from the call sites.
+	*/
+	constexpr auto assert_pat(image_address display_assert_offset, image_address system_debugger_present_offset)
+	{
+		return make_pattern(
+			PAT_BYTES(2, { 0x6A, 0x01}), //  push 1 (is fatal)
+			PAT_BYTE(0x68), PAT_ANY(4),  //  push c_line
+			PAT_BYTE(0x68), PAT_ANY(4),  //  push c_filename
+			PAT_BYTE(0x68), PAT_ANY(4),  //  push c_assertion_message
+			PAT_CALL(display_assert_offset), // call display_assert
+			PAT_BYTES(3, { 0x83, 0xC4, 0x10}), // add esp, 10h
+			PAT_CALL(system_debugger_present_offset) // call system_debugger_present
+		);
+	}
+
+	/*
+	* Assert sites with any call targets, so they can be scanned for in the same pass as hs_assert and then checked with is_assert_site
+	*/
+	constexpr auto assert_candidate_pat = make_pattern(
+		PAT_BYTES(2, { 0x6A, 0x01}), //  push 1 (is fatal)
+		PAT_BYTE(0x68), PAT_ANY(4),  //  push c_line
+		PAT_BYTE(0x68), PAT_ANY(4),  //  push c_filename
+		PAT_BYTE(0x68), PAT_ANY(4),  //  push c_assertion_message
+		PAT_BYTE(0xE8), PAT_ANY(4), // call display_assert
+		PAT_BYTES(3, { 0x83, 0xC4, 0x10}), // add esp, 10h
+		PAT_BYTE(0xE8), PAT_ANY(4) // call system_debugger_present
+	);
+	constexpr image_address assert_candidate_display_assert_call = 0x11;
+	constexpr image_address assert_candidate_system_debugger_present_call = 0x19;
+
+	/*
+	* Checks if a match for assert_candidate_pat calls the same functions as assert_pat
+	*/
+	inline bool is_assert_site(const PatternScanner& scanner, image_address candidate, image_address display_assert_offset, image_address system_debugger_present_offset)
+	{
+		return scanner.get_call_target(candidate + assert_candidate_display_assert_call) == display_assert_offset
+			&& scanner.get_call_target(candidate + assert_candidate_system_debugger_present_call) == system_debugger_present_offset;
+	}
+
+	constexpr auto cuban_lightmap_setting = make_pattern(
+		PAT_STRING_XREF("cuban"),
+		PAT_POD_TYPE(int32_t(1)), // subpixel count
+		PAT_POD_TYPE(int32_t(1)), // monte carlo sample count
+		PAT_POD_TYPE(int32_t(0)), // is_draft
+		PAT_POD_TYPE(int32_t(50000)), // photon count
+		PAT_POD_TYPE(int32_t(0)), // unknown
+		PAT_POD_TYPE(float(1.0f)), // search distance setting
+		PAT_POD_TYPE(int32_t(0)) // is checkboard
+	);
+
+	/*
+	* The same signatures in the BytecodePattern text format, assert_pat_text calls the display_assert and system_debugger_present symbols
+	*/
+	constexpr char hs_assert_text[] = R"sig(
+		6A 01                  # push 1 (is fatal)
+		68 [2560..3360]        # push c_line_number
+		68 ?? ?? ?? ??         # push c_file_name
+		68 "hs_type_valid(definition->return_type)"
+	)sig";
+
+	constexpr char assert_pat_text[] = R"sig(
+		6A 01                  # push 1 (is fatal)
+		68 ?? ?? ?? ??         # push c_line
+		68 ?? ?? ?? ??         # push c_filename
+		68 ?? ?? ?? ??         # push c_assertion_message
+		call:display_assert
+		83 C4 10               # add esp, 10h
+		call:system_debugger_present
+	)sig";
+
+	constexpr char cuban_lightmap_setting_text[] = R"sig(
+		"cuban"
+		i32:1                  # subpixel count
+		i32:1                  # monte carlo sample count
+		i32:0                  # is_draft
+		i32:50000              # photon count
+		i32:0                  # unknown
+		f32:1.0                # search distance setting
+		i32:0                  # is checkboard
+	)sig";
+}
@@ -7,6 +7,7 @@
 
 #include "platform.h"
 #include "H2ToolHooks.h"
+#include "PatchTransaction.h"
 #include "Debug.h"
 #include <cstdio>
 #include <iostream>
@@ -69,14 +70,17 @@ BOOL APIENTRY DllMain( HMODULE hModule,
 
         if (flags == 0 && !is_launcher_variable_set("EVENT"))
         {
-            DebugPrintf("[DLL FIX] Not injected by launcher?! Enabling assertions patch. Safe flying pilot.");
+            LOG_WARNING("[DLL FIX] Not injected by launcher?! Enabling assertions patch. Safe flying pilot.");
             flags |= H2ToolHooks::HookFlags::DisableAsserts;
         }
 
+        if (is_launcher_variable_set("INSTRUCTION_BOUNDARIES"))
+            flags |= H2ToolHooks::HookFlags::InstructionBoundaries;
+
         if (!H2ToolHooks::hook(static_cast<H2ToolHooks::HookFlags>(flags)))
         {
-            DebugPrintf("[DLL FIX] FAILURE?");
-            DebugPrintf("[DLL FIX] Failed to apply launcher hooks to tool. This is quite bad.");
+            LOG_ERROR("[DLL FIX] FAILURE?");
+            LOG_ERROR("[DLL FIX] Failed to apply launcher hooks to tool. This is quite bad.");
 
         }
         else
@@ -89,22 +93,22 @@ BOOL APIENTRY DllMain( HMODULE hModule,
                 {
                     if (!SetEvent(event))
                     {
-                        DebugPrintf("[DLL FIX] Failed to communicate back to launcher: %x!", GetLastError());
+                        LOG_ERROR("[DLL FIX] Failed to communicate back to launcher: %x!", GetLastError());
                     }
                     else
                     {
-                        DebugPrintf("[DLL FIX] Injected successfully!");
+                        LOG_INFO("[DLL FIX] Injected successfully!");
                     }
                     CloseHandle(event);
                 }
                 else
                 {
-                    DebugPrintf("[DLL FIX] Failed to open event");
+                    LOG_ERROR("[DLL FIX] Failed to open event");
                 }
             }
             else
             {
-                DebugPrintf("[DLL FIX] Failed to get injector event name!");
+                LOG_ERROR("[DLL FIX] Failed to get injector event name!");
             }
         }
 
@@ -112,8 +116,14 @@ BOOL APIENTRY DllMain( HMODULE hModule,
     }
     case DLL_THREAD_ATTACH:
     case DLL_THREAD_DETACH:
+        // the log drain thread comes through here too, it must not stop to wait for input
+        break;
     case DLL_PROCESS_DETACH:
-        
+        // something running in tool since it was injected could have written over them
+        if (!H2ToolHooks::get_patches().verify())
+            LOG_WARNING("[DLL FIX] Some of the patches were overwritten while tool was running");
+        Logger::global().flush();
+
         if (pause_on_exit)
         {
             std::string _;
@@ -6,6 +6,12 @@
 
 #pragma once
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
 // Windows Header Files
 #include <windows.h>
+#else
+// SAL annotations used by the code shared with the offline tools
+#define _In_z_
+#define _Printf_format_string_
+#endif
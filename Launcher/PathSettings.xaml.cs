@@ -296,6 +296,7 @@ namespace ToolkitLauncher
                 is_mcc.IsChecked = ToolkitProfiles.SettingsList[profile_index].IsAlternativeBuild;
                 community_tools.IsChecked = ToolkitProfiles.SettingsList[profile_index].CommunityTools;
 				disable_assertions.IsChecked = ToolkitProfiles.SettingsList[profile_index].DisableAssertions;
+				hooks_instruction_boundaries.IsChecked = ToolkitProfiles.SettingsList[profile_index].HooksInstructionBoundaries;
                 verbose.IsChecked = ToolkitProfiles.SettingsList[profile_index].Verbose;
                 expert_mode.IsChecked = ToolkitProfiles.SettingsList[profile_index].ExpertMode;
                 batch.IsChecked = ToolkitProfiles.SettingsList[profile_index].Batch;
@@ -350,6 +351,7 @@ namespace ToolkitLauncher
                 IsAlternativeBuild = (bool)is_mcc.IsChecked,
                 CommunityTools = (bool)community_tools.IsChecked,
                 DisableAssertions = (bool)disable_assertions.IsChecked,
+                HooksInstructionBoundaries = (bool)hooks_instruction_boundaries.IsChecked,
                 Verbose = (bool)verbose.IsChecked,
                 ExpertMode = (bool)expert_mode.IsChecked,
                 Batch = (bool)batch.IsChecked,
@@ -399,10 +399,12 @@ namespace ToolkitLauncher.ToolkitInterface
 
 		protected override Utility.Process.InjectionConfig? ModifyInjectionSettings(ToolType tool, Utility.Process.InjectionConfig? requestedConfig)
 		{
-			static void ModifyEnviroment(IDictionary<string, string?> Enviroment)
+			void ModifyEnviroment(IDictionary<string, string?> Enviroment)
 			{
                 Enviroment["DONT_TREAD_ON_ME_WITH_DEBUGGING_DIALOGS"] = "no_step_on_snek";
                 Enviroment[DLLInjector.GetVariableName("DISABLE_ASSERTIONS")] = "1";
+                if (Profile.HooksInstructionBoundaries)
+                    Enviroment[DLLInjector.GetVariableName("INSTRUCTION_BOUNDARIES")] = "1";
 			}
 
 			bool is_game_engine_build = tool == ToolType.Sapien || tool == ToolType.Game || tool == ToolType.Guerilla;
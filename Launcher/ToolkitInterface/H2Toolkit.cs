@@ -53,11 +53,13 @@ namespace ToolkitLauncher.ToolkitInterface
             await RunTool(ToolType.Tool, new List<string>() { "build-cache-file", scenario.Replace(".scenario", "") });
         }
 
-        static private DLLInjector GetLightmapConfigInjector()
+        private DLLInjector GetLightmapConfigInjector()
         {
-			static void ModifyEnviroment(IDictionary<string, string?> Enviroment)
+			void ModifyEnviroment(IDictionary<string, string?> Enviroment)
 			{
 				Enviroment[DLLInjector.GetVariableName("PATCH_QUALITY")] = "1";
+				if (Profile.HooksInstructionBoundaries)
+					Enviroment[DLLInjector.GetVariableName("INSTRUCTION_BOUNDARIES")] = "1";
 			}
 
             return new(Resources.H2ToolHooks, "h2.patch.lightmap-quality.dll", ModifyEnviroment, earlyInjection: true);
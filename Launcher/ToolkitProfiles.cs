@@ -119,6 +119,12 @@ namespace ToolkitLauncher
             [JsonPropertyName("reach_color_assert_fix")]
             public bool ReachColorAssertFix { get; set; } = false;
 
+            /// <summary>
+            /// Only let the tool hooks match their signatures at instruction starts, slower but can't match the middle of an instruction
+            /// </summary>
+            [JsonPropertyName("hooks_instruction_boundaries")]
+            public bool HooksInstructionBoundaries { get; set; } = false;
+
 			/// <summary>
 			/// Whatever we should temporarily be experts
 			/// </summary>
@@ -3,6 +3,7 @@ using System.Collections.Generic;
 using System.ComponentModel;
 using System.Diagnostics;
 using System.IO;
+using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
 using System.Runtime.Versioning;
 using System.Text;
@@ -152,8 +153,147 @@ namespace ToolkitLauncher.Utility
             _32bitHelperPathLock = new(_32bitHelperPath, FileMode.Open, FileAccess.Read, FileShare.Read);
 		}
 
+        [StructLayout(LayoutKind.Sequential)]
+        private struct MEMORY_BASIC_INFORMATION
+        {
+            public IntPtr BaseAddress;
+            public IntPtr AllocationBase;
+            public uint AllocationProtect;
+            public ushort PartitionId;
+            public nuint RegionSize;
+            public uint State;
+            public uint Protect;
+            public uint Type;
+        }
+
+        private const uint MEM_IMAGE = 0x1000000;
+
+        [DllImport("KERNEL32.dll", ExactSpelling = true, SetLastError = true)]
+        [DefaultDllImportSearchPaths(DllImportSearchPath.System32)]
+        private static extern nuint VirtualQueryEx(IntPtr hProcess, IntPtr lpAddress, out MEMORY_BASIC_INFORMATION lpBuffer, nuint dwLength);
+
+        [DllImport("KERNEL32.dll", ExactSpelling = true, SetLastError = true, CharSet = CharSet.Unicode)]
+        [DefaultDllImportSearchPaths(DllImportSearchPath.System32)]
+        private static extern uint K32GetMappedFileNameW(IntPtr hProcess, IntPtr lpv, StringBuilder lpFilename, uint nSize);
+
+        static Dictionary<string, PEExports?> _32bit_exports_cache = new();
+        // the module map of each target, walking the address space takes a VirtualQueryEx call per region
+        static readonly ConditionalWeakTable<System.Diagnostics.Process, Dictionary<string, IntPtr>> _32bit_module_bases_cache = new();
+
+        private static string NormaliseModuleName(string moduleName)
+        {
+            moduleName = moduleName.Trim().ToLowerInvariant();
+            return Path.HasExtension(moduleName) ? moduleName : moduleName + ".dll";
+        }
+
+        /// <summary>
+        /// Find where every 32-bit DLL is mapped in a WOW64 process, works while it is suspended before the loader has run
+        /// as long as the image is mapped, which ntdll always is.
+        /// </summary>
+        /// <returns>Base address of each image by lowercase file name</returns>
+        private static Dictionary<string, IntPtr> GetModuleBases32(System.Diagnostics.Process process)
+        {
+            Dictionary<string, IntPtr> modules = new();
+            StringBuilder fileName = new(1024);
+            // 32-bit images are all below 4GB, the 64-bit ntdll and the WOW64 layer are mapped above that
+            ulong address = 0;
+            while (address < 0x1_0000_0000 && VirtualQueryEx(process.Handle, new IntPtr((long)address), out MEMORY_BASIC_INFORMATION info, (nuint)Marshal.SizeOf<MEMORY_BASIC_INFORMATION>()) != 0)
+            {
+                if (info.Type == MEM_IMAGE && info.BaseAddress == info.AllocationBase
+                    && K32GetMappedFileNameW(process.Handle, info.BaseAddress, fileName, (uint)fileName.Capacity) != 0)
+                    modules.TryAdd(Path.GetFileName(fileName.ToString()).ToLowerInvariant(), info.BaseAddress);
+                address = (ulong)info.BaseAddress.ToInt64() + info.RegionSize;
+            }
+            return modules;
+        }
+
+        /// <summary>
+        /// Where <c>moduleName</c> is mapped in a WOW64 process. The module map is cached per process and only walked again
+        /// if the module isn't in it, as the process may have loaded more DLLs since (e.g. it was suspended before the loader ran).
+        /// </summary>
+        private static bool TryGetModuleBase32(System.Diagnostics.Process process, string moduleName, out IntPtr moduleBase)
+        {
+            lock (_32bit_module_bases_cache)
+            {
+                if (_32bit_module_bases_cache.TryGetValue(process, out Dictionary<string, IntPtr>? modules) && modules.TryGetValue(moduleName, out moduleBase))
+                    return true;
+                modules = GetModuleBases32(process);
+                _32bit_module_bases_cache.AddOrUpdate(process, modules);
+                return modules.TryGetValue(moduleName, out moduleBase);
+            }
+        }
+
+        /// <summary>
+        /// API set contracts (<c>api-ms-*</c>, <c>ext-ms-*</c>) aren't files, the loader maps them to a host DLL with the API set schema.
+        /// </summary>
+        private static bool IsApiSetName(string moduleName)
+        {
+            return moduleName.StartsWith("api-ms-", StringComparison.OrdinalIgnoreCase) || moduleName.StartsWith("ext-ms-", StringComparison.OrdinalIgnoreCase);
+        }
+
+        private static PEExports? GetExports32(string moduleName)
+        {
+            lock (_32bit_exports_cache)
+            {
+                if (!_32bit_exports_cache.TryGetValue(moduleName, out PEExports? exports))
+                {
+                    exports = PEExports.Load(Path.Combine(Environment.GetFolderPath(Environment.SpecialFolder.SystemX86), moduleName));
+                    _32bit_exports_cache[moduleName] = exports;
+                }
+                return exports;
+            }
+        }
+
+        /// <summary>
+        /// Get the address of a procedure in a WOW64 process from the export table of the 32-bit DLL on disk and where it is mapped
+        /// in the process, following forwarders into other DLLs.
+        /// Forwarders to an API set aren't followed, that needs the API set schema which isn't read here. Those lookups return null
+        /// and the caller falls back to the helper. Nothing the injector looks up (LdrLoadDll, LoadLibraryA in KernelBase) is forwarded.
+        /// </summary>
+        /// <param name="process"></param>
+        /// <param name="moduleName"></param>
+        /// <param name="procName">Name or <c>#ordinal</c></param>
+        /// <returns>The address, or null if the DLL isn't mapped in the process or doesn't export it</returns>
+        static private FARPROC ResolveLibraryProcAddress32(System.Diagnostics.Process process, string moduleName, string procName)
+        {
+            moduleName = NormaliseModuleName(moduleName);
+            procName = procName.Trim();
+            // forwarders could go around in a loop
+            for (int depth = 0; depth < 16; depth++)
+            {
+                PEExports? exports = GetExports32(moduleName);
+                if (exports is null || !exports.TryFind(procName, out PEExports.Export export))
+                {
+                    Trace.WriteLine($"{procName} isn't exported by {moduleName}, or it couldn't be read");
+                    return FARPROC.Null;
+                }
+
+                if (!export.IsForwarded)
+                {
+                    if (!TryGetModuleBase32(process, moduleName, out IntPtr moduleBase))
+                    {
+                        Trace.WriteLine($"{moduleName} isn't mapped in the target process");
+                        return FARPROC.Null;
+                    }
+                    return new FARPROC(moduleBase + (nint)export.Rva);
+                }
+
+                int separator = export.Forwarder!.LastIndexOf('.');
+                if (separator <= 0)
+                    return FARPROC.Null;
+                moduleName = NormaliseModuleName(export.Forwarder.Substring(0, separator));
+                procName = export.Forwarder.Substring(separator + 1);
+                if (IsApiSetName(moduleName))
+                {
+                    Trace.WriteLine($"{procName} is forwarded to the API set {moduleName}, which can't be resolved from disk");
+                    return FARPROC.Null;
+                }
+            }
+            return FARPROC.Null;
+        }
+
         /// <summary>
-        /// Get the address of a procdure. Only works for a few special libararies that are mapped at the same address in all modules
+        /// Get the address of a procdure using the helper exe. Only works for a few special libararies that are mapped at the same address in all modules
         /// </summary>
         /// <param name="moduleName"></param>
         /// <param name="procName"></param>
@@ -212,12 +352,23 @@ namespace ToolkitLauncher.Utility
 			}
             else
             {
-				Trace.WriteLine($"32-bit target process, getting {procName} the hard way using helper exe");
-				procAddr = await GetLibraryProcAddress32(moduleName, procName);
+				Trace.WriteLine($"32-bit target process, getting {procName} from the export table on disk");
+				procAddr = ResolveLibraryProcAddress32(process, moduleName, procName);
                 if (procAddr == FARPROC.Null && moduleNameBackup is not null)
                 {
-                    procAddr = await GetLibraryProcAddress32(moduleNameBackup, procName);
-				}
+                    procAddr = ResolveLibraryProcAddress32(process, moduleNameBackup, procName);
+                }
+
+                // only needed if the DLL couldn't be read or found in the process
+                if (procAddr == FARPROC.Null)
+                {
+                    Trace.WriteLine($"Falling back to getting {procName} the hard way using helper exe");
+                    procAddr = await GetLibraryProcAddress32(moduleName, procName);
+                    if (procAddr == FARPROC.Null && moduleNameBackup is not null)
+                    {
+                        procAddr = await GetLibraryProcAddress32(moduleNameBackup, procName);
+                    }
+                }
 			}
 
             return procAddr;
@@ -0,0 +1,207 @@
+﻿using System;
+using System.Buffers.Binary;
+using System.Collections.Generic;
+using System.IO;
+using System.Text;
+
+namespace ToolkitLauncher.Utility
+{
+    /// <summary>
+    /// Export table of a PE image read from the file on disk, a port of PEExports in H2ToolHooks.
+    /// The native parser would have to be shipped as a second native DLL built for the launcher's own architecture,
+    /// the port lets injection read export tables in-process without one. CI lists the exports of the system DLLs
+    /// with this and with ResolveExports and checks they agree, see ManagedListExports.
+    /// </summary>
+    public class PEExports
+    {
+        /// <summary>
+        /// <c>Name</c> is the first name the function is exported under, null if it is only exported by ordinal
+        /// </summary>
+        public readonly record struct Export(ushort Ordinal, uint Rva, string? Forwarder, string? Name = null)
+        {
+            /// <summary>
+            /// `MODULE.Name` or `MODULE.#ordinal` if the export is implemented by another DLL
+            /// </summary>
+            public bool IsForwarded => Forwarder is not null;
+        }
+
+        /// <summary>
+        /// The name the DLL was linked as
+        /// </summary>
+        public string ModuleName { get; private set; } = "";
+
+        readonly private Dictionary<string, Export> _names = new();
+        readonly private Dictionary<ushort, Export> _ordinals = new();
+        readonly private List<Export> _exports = new();
+
+        /// <summary>
+        /// Every exported function by ordinal, without the unused ordinals
+        /// </summary>
+        public IReadOnlyList<Export> Exports => _exports;
+
+        public uint OrdinalBase { get; private set; }
+
+        /// <summary>
+        /// Read the export table of the DLL at <c>path</c>
+        /// </summary>
+        /// <returns>The exports, or null if the file couldn't be read or isn't a valid PE image</returns>
+        public static PEExports? Load(string path)
+        {
+            byte[] data;
+            try
+            {
+                data = File.ReadAllBytes(path);
+            }
+            catch (Exception ex) when (ex is IOException or UnauthorizedAccessException)
+            {
+                return null;
+            }
+            return Parse(data);
+        }
+
+        /// <summary>
+        /// Parse the export table of a PE image as it's laid out in the file
+        /// </summary>
+        /// <returns>The exports, or null if it isn't a valid PE image</returns>
+        public static PEExports? Parse(byte[] data)
+        {
+            try
+            {
+                return ParseImage(data);
+            }
+            catch (ArgumentOutOfRangeException)
+            {
+                // something points outside the file
+                return null;
+            }
+        }
+
+        /// <summary>
+        /// Look up an export, <c>#ordinal</c> looks it up by ordinal and anything else by name
+        /// </summary>
+        public bool TryFind(string symbol, out Export export)
+        {
+            if (symbol.Length > 1 && symbol[0] == '#' && ushort.TryParse(symbol.AsSpan(1), out ushort ordinal))
+                return _ordinals.TryGetValue(ordinal, out export);
+            return _names.TryGetValue(symbol, out export);
+        }
+
+        private readonly record struct Section(uint VirtualAddress, uint VirtualSize, uint RawOffset, uint RawSize);
+
+        private static ReadOnlySpan<byte> AtRva(byte[] data, List<Section> sections, uint rva)
+        {
+            foreach (Section section in sections)
+            {
+                uint size = Math.Min(section.VirtualSize == 0 ? section.RawSize : section.VirtualSize, section.RawSize);
+                if (rva >= section.VirtualAddress && rva - section.VirtualAddress < size)
+                    return data.AsSpan((int)(section.RawOffset + (rva - section.VirtualAddress)), (int)(size - (rva - section.VirtualAddress)));
+            }
+            throw new ArgumentOutOfRangeException(nameof(rva));
+        }
+
+        private static string StringAtRva(byte[] data, List<Section> sections, uint rva)
+        {
+            ReadOnlySpan<byte> contents = AtRva(data, sections, rva);
+            int length = contents.IndexOf((byte)0);
+            if (length < 0)
+                throw new ArgumentOutOfRangeException(nameof(rva));
+            return Encoding.ASCII.GetString(contents.Slice(0, length));
+        }
+
+        private static PEExports? ParseImage(byte[] data)
+        {
+            ReadOnlySpan<byte> image = data;
+            if (BinaryPrimitives.ReadUInt16LittleEndian(image) != 0x5A4D) // MZ
+                return null;
+            int ntOffset = (int)BinaryPrimitives.ReadUInt32LittleEndian(image.Slice(0x3C));
+            if (ntOffset < 0 || BinaryPrimitives.ReadUInt32LittleEndian(image.Slice(ntOffset)) != 0x4550) // PE\0\0
+                return null;
+
+            int fileHeader = ntOffset + 4;
+            int sectionCount = BinaryPrimitives.ReadUInt16LittleEndian(image.Slice(fileHeader + 2));
+            int optionalHeaderSize = BinaryPrimitives.ReadUInt16LittleEndian(image.Slice(fileHeader + 16));
+            int optionalHeader = fileHeader + 20;
+            int directories = BinaryPrimitives.ReadUInt16LittleEndian(image.Slice(optionalHeader)) switch
+            {
+                0x10B => optionalHeader + 96,
+                0x20B => optionalHeader + 112,
+                _ => -1
+            };
+            if (directories < 0)
+                return null;
+            // NumberOfRvaAndSizes, without any directories there is no export directory either
+            if (BinaryPrimitives.ReadUInt32LittleEndian(image.Slice(directories - 4)) == 0)
+                return new PEExports();
+
+            List<Section> sections = new();
+            for (int i = 0; i < sectionCount; i++)
+            {
+                ReadOnlySpan<byte> header = image.Slice(optionalHeader + optionalHeaderSize + i * 40, 40);
+                sections.Add(new Section(
+                    BinaryPrimitives.ReadUInt32LittleEndian(header.Slice(12)),
+                    BinaryPrimitives.ReadUInt32LittleEndian(header.Slice(8)),
+                    BinaryPrimitives.ReadUInt32LittleEndian(header.Slice(20)),
+                    BinaryPrimitives.ReadUInt32LittleEndian(header.Slice(16))));
+            }
+
+            PEExports exports = new();
+            uint directoryRva = BinaryPrimitives.ReadUInt32LittleEndian(image.Slice(directories));
+            uint directorySize = BinaryPrimitives.ReadUInt32LittleEndian(image.Slice(directories + 4));
+            if (directoryRva == 0 || directorySize == 0)
+                return exports;
+
+            // IMAGE_EXPORT_DIRECTORY
+            ReadOnlySpan<byte> directory = AtRva(data, sections, directoryRva);
+            uint ordinalBase = BinaryPrimitives.ReadUInt32LittleEndian(directory.Slice(16));
+            exports.OrdinalBase = ordinalBase;
+            uint functionCount = BinaryPrimitives.ReadUInt32LittleEndian(directory.Slice(20));
+            uint nameCount = BinaryPrimitives.ReadUInt32LittleEndian(directory.Slice(24));
+            if (functionCount > 0x10000 || nameCount > functionCount || ordinalBase + (ulong)functionCount > 0x10000)
+                return null;
+            exports.ModuleName = StringAtRva(data, sections, BinaryPrimitives.ReadUInt32LittleEndian(directory.Slice(12)));
+
+            // index into _exports for every function
+            int[] functions = new int[functionCount];
+            Array.Fill(functions, -1);
+            if (functionCount != 0)
+            {
+                ReadOnlySpan<byte> addresses = AtRva(data, sections, BinaryPrimitives.ReadUInt32LittleEndian(directory.Slice(28)));
+                for (int i = 0; i < functionCount; i++)
+                {
+                    uint rva = BinaryPrimitives.ReadUInt32LittleEndian(addresses.Slice(i * 4));
+                    if (rva == 0)
+                        continue;
+                    // an address inside the export directory is the name of the export it forwards to
+                    bool isForwarded = rva >= directoryRva && rva - directoryRva < directorySize;
+                    string? forwarder = isForwarded ? StringAtRva(data, sections, rva) : null;
+                    if (forwarder is { Length: 0 })
+                        return null;
+                    functions[i] = exports._exports.Count;
+                    exports._exports.Add(new((ushort)(ordinalBase + i), isForwarded ? 0 : rva, forwarder));
+                }
+            }
+
+            if (nameCount != 0)
+            {
+                ReadOnlySpan<byte> names = AtRva(data, sections, BinaryPrimitives.ReadUInt32LittleEndian(directory.Slice(32)));
+                ReadOnlySpan<byte> nameOrdinals = AtRva(data, sections, BinaryPrimitives.ReadUInt32LittleEndian(directory.Slice(36)));
+                for (int i = 0; i < nameCount; i++)
+                {
+                    ushort index = BinaryPrimitives.ReadUInt16LittleEndian(nameOrdinals.Slice(i * 2));
+                    string name = StringAtRva(data, sections, BinaryPrimitives.ReadUInt32LittleEndian(names.Slice(i * 4)));
+                    if (index >= functionCount || functions[index] < 0 || name.Length == 0)
+                        return null;
+                    // a function can be exported under more than one name, Exports only gives the first
+                    if (exports._exports[functions[index]].Name is null)
+                        exports._exports[functions[index]] = exports._exports[functions[index]] with { Name = name };
+                    exports._names[name] = exports._exports[functions[index]];
+                }
+            }
+
+            foreach (Export export in exports._exports)
+                exports._ordinals[export.Ordinal] = export;
+
+            return exports;
+        }
+    }
+}
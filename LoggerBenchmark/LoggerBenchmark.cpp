@@ -0,0 +1,240 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+/*
+	Benchmarks how long logging holds up the threads doing it, comparing printing each message as it's logged
+	(what DebugPrintf did) with queueing it in Logger, formatted straight away or deferred to the drain thread.
+	The queued modes are run dropping messages once the buffer is full, waiting for room like the hooks do, and with a
+	buffer big enough for every message. A dropped message is far cheaper than a written one, so the times only compare
+	fairly when `dropped_fraction` is 0.
+	Every result is printed as one JSON object per line, the same as ScannerBenchmark.
+	Built by LoggerBenchmark.vcxproj on windows, elsewhere build it directly:
+		g++ -std=c++17 -O2 -I../H2ToolHooks LoggerBenchmark.cpp ../H2ToolHooks/Logger.cpp -pthread -o LoggerBenchmark
+*/
+
+#include "Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Options
+{
+	size_t message_count = 20000;
+	size_t capacity = 0x100;
+	size_t iterations = 5;
+	unsigned sink_delay_us = 0;
+	std::string output_path =
+#ifdef _WIN32
+		"NUL";
+#else
+		"/dev/null";
+#endif
+};
+
+/*
+	Stands in for the console, `delay_us` makes every line as slow as a console that's being scrolled
+*/
+struct OutputSink
+{
+	FILE* file;
+	unsigned delay_us;
+	size_t written_count;
+
+	void write_line(const char* message) {
+		fputs(message, file);
+		fputc('\n', file);
+		fflush(file);
+		if (delay_us != 0)
+			std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+		written_count++;
+	}
+};
+
+static void write_to_output(LogLevel, const char* message, void* context)
+{
+	static_cast<OutputSink*>(context)->write_line(message);
+}
+
+/*
+	What DebugPrintf did, format and print on the thread logging
+*/
+static void print_blocking(OutputSink& sink, const char* format, ...)
+{
+	char message[0x1000];
+	va_list arguments;
+	va_start(arguments, format);
+	vsnprintf(message, sizeof(message), format, arguments);
+	va_end(arguments);
+	sink.write_line(message);
+}
+
+enum class Mode
+{
+	Blocking,
+	Formatted,
+	Deferred
+};
+
+/*
+	Runs `thread_count` threads logging `message_count` messages between them and prints the timings.
+	`producer` is how long the logging threads took, `total` also waits for every message to be written out.
+	Returns false if a message was neither written nor counted as dropped, or was dropped while waiting for room.
+*/
+static bool run_benchmark(const Options& options, const char* name, Mode mode, Logger::FullPolicy full_policy, size_t thread_count)
+{
+	std::vector<double> producer_times;
+	std::vector<double> total_times;
+	size_t written_count = 0;
+	size_t dropped_count = 0;
+	bool is_ok = true;
+	for (size_t i = 0; i < options.iterations; i++) {
+		FILE* file = fopen(options.output_path.c_str(), "w");
+		if (!file) {
+			fprintf(stderr, "Failed to open %s\n", options.output_path.c_str());
+			return false;
+		}
+		OutputSink sink = { file, options.sink_delay_us, 0 };
+		// destroyed before the file is closed
+		auto logger_storage = std::make_unique<Logger>(write_to_output, &sink, options.capacity, full_policy);
+		Logger& logger = *logger_storage;
+		logger.start();
+		// printing from several threads at once needs a lock, which the console had
+		std::mutex blocking_lock;
+
+		const size_t messages_per_thread = options.message_count / thread_count;
+		const auto start_time = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (size_t thread_index = 0; thread_index < thread_count; thread_index++) {
+			threads.emplace_back([&, thread_index]() {
+				const char* label = thread_index & 1 ? "display_assert" : "system_debugger_present";
+				for (size_t message = 0; message < messages_per_thread; message++) {
+					const size_t offset = 0x401000 + message * 0x10;
+					switch (mode) {
+					case Mode::Blocking: {
+						std::lock_guard<std::mutex> lock(blocking_lock);
+						print_blocking(sink, "%s offset: %zx, %d asserts", label, offset, static_cast<int>(message));
+						break;
+					}
+					case Mode::Formatted:
+						logger.write(LogLevel::Info, "%s offset: %zx, %d asserts", label, offset, static_cast<int>(message));
+						break;
+					case Mode::Deferred:
+						logger.write_deferred(LogLevel::Info, "%s offset: %zx, %d asserts", label, offset, static_cast<int>(message));
+						break;
+					}
+				}
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+		const auto producer_time = std::chrono::steady_clock::now();
+		logger.flush();
+		const auto end_time = std::chrono::steady_clock::now();
+
+		producer_times.push_back(std::chrono::duration<double, std::milli>(producer_time - start_time).count());
+		total_times.push_back(std::chrono::duration<double, std::milli>(end_time - start_time).count());
+		dropped_count = logger.get_dropped_count();
+		// the drop warning is written out as well
+		written_count = sink.written_count - (dropped_count != 0 ? 1 : 0);
+		is_ok = written_count + dropped_count == messages_per_thread * thread_count && is_ok;
+		is_ok = (full_policy != Logger::FullPolicy::Wait || dropped_count == 0) && is_ok;
+		logger_storage.reset();
+		fclose(file);
+	}
+
+	std::sort(producer_times.begin(), producer_times.end());
+	std::sort(total_times.begin(), total_times.end());
+	const double producer_median = producer_times[producer_times.size() / 2];
+	const size_t message_count = options.message_count / thread_count * thread_count;
+	printf("{\"benchmark\":\"%s\",\"threads\":%zu,\"messages\":%zu,\"capacity\":%zu,\"sink_delay_us\":%u,\"iterations\":%zu,"
+		"\"producer_min_ms\":%.3f,\"producer_median_ms\":%.3f,\"total_median_ms\":%.3f,\"ns_per_message\":%.1f,\"dropped_fraction\":%.3f,"
+		"\"written\":%zu,\"dropped\":%zu,\"ok\":%s}\n",
+		name, thread_count, message_count, options.capacity, options.sink_delay_us, producer_times.size(),
+		producer_times.front(), producer_median, total_times[total_times.size() / 2], producer_median * 1000000.0 / message_count,
+		static_cast<double>(dropped_count) / message_count, written_count, dropped_count, is_ok ? "true" : "false");
+	fflush(stdout);
+	return is_ok;
+}
+
+static bool parse_number(const char* string, size_t& value)
+{
+	char* end;
+	value = static_cast<size_t>(strtoull(string, &end, 0));
+	return *string != '\0' && *end == '\0';
+}
+
+static void print_usage(const char* program)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  --messages <count>       messages logged per run (default 20000)\n"
+		"  --capacity <count>       records in the ring buffer (default 0x100, what the hooks use)\n"
+		"  --iterations <count>     runs per benchmark, the median is reported (default 5)\n"
+		"  --sink-delay <us>        time every line takes to write out, to stand in for a slow console (default 0)\n"
+		"  --output <path>          where the lines are written (default the null device)\n",
+		program);
+}
+
+// LoggerBenchmark [options], exits with 1 if a message went missing
+int main(int argc, char* argv[])
+{
+	Options options;
+	for (int i = 1; i < argc; i += 2) {
+		const std::string argument = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		size_t number = 0;
+		bool is_valid = true;
+		if (!value) {
+			is_valid = false;
+		}
+		else if (argument == "--messages") {
+			is_valid = parse_number(value, options.message_count) && options.message_count > 0;
+		}
+		else if (argument == "--capacity") {
+			is_valid = parse_number(value, options.capacity) && options.capacity > 0;
+		}
+		else if (argument == "--iterations") {
+			is_valid = parse_number(value, options.iterations) && options.iterations > 0;
+		}
+		else if (argument == "--sink-delay") {
+			is_valid = parse_number(value, number);
+			options.sink_delay_us = static_cast<unsigned>(number);
+		}
+		else if (argument == "--output") {
+			options.output_path = value;
+		}
+		else {
+			is_valid = false;
+		}
+
+		if (!is_valid) {
+			print_usage(argv[0]);
+			return 2;
+		}
+	}
+
+	// the whole burst fits in the buffer, what logging costs while the drain keeps up
+	Options burst_options = options;
+	burst_options.capacity = std::max(options.capacity, options.message_count);
+
+	bool is_ok = true;
+	for (const size_t thread_count : { 1, 4 }) {
+		is_ok = run_benchmark(options, "blocking", Mode::Blocking, Logger::FullPolicy::Drop, thread_count) && is_ok;
+		is_ok = run_benchmark(options, "formatted", Mode::Formatted, Logger::FullPolicy::Drop, thread_count) && is_ok;
+		is_ok = run_benchmark(options, "deferred", Mode::Deferred, Logger::FullPolicy::Drop, thread_count) && is_ok;
+		is_ok = run_benchmark(options, "formatted_wait", Mode::Formatted, Logger::FullPolicy::Wait, thread_count) && is_ok;
+		is_ok = run_benchmark(options, "deferred_wait", Mode::Deferred, Logger::FullPolicy::Wait, thread_count) && is_ok;
+		is_ok = run_benchmark(burst_options, "formatted_burst", Mode::Formatted, Logger::FullPolicy::Wait, thread_count) && is_ok;
+		is_ok = run_benchmark(burst_options, "deferred_burst", Mode::Deferred, Logger::FullPolicy::Wait, thread_count) && is_ok;
+	}
+	return is_ok ? 0 : 1;
+}
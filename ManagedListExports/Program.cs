@@ -0,0 +1,41 @@
+﻿using System;
+using ToolkitLauncher.Utility;
+
+namespace ManagedListExports
+{
+    /// <summary>
+    /// Prints the export table of a DLL with the launcher's PEExports, in the same format as <c>ResolveExports --list</c>
+    /// so the two parsers can be compared on the same files. Runs anywhere .NET does.
+    /// </summary>
+    internal static class Program
+    {
+        static int Main(string[] args)
+        {
+            if (args.Length != 1)
+            {
+                Console.Error.WriteLine("usage: ManagedListExports <dll>");
+                return 2;
+            }
+
+            PEExports? exports = PEExports.Load(args[0]);
+            if (exports is null)
+            {
+                Console.Error.WriteLine($"{args[0]} couldn't be read or isn't a valid PE image");
+                return 2;
+            }
+
+            Console.Out.NewLine = "\n";
+            Console.WriteLine($"module: {exports.ModuleName}");
+            Console.WriteLine($"ordinal_base: {exports.OrdinalBase}");
+            foreach (PEExports.Export export in exports.Exports)
+            {
+                string name = export.Name ?? "(ordinal only)";
+                if (export.IsForwarded)
+                    Console.WriteLine($"{export.Ordinal} {name} -> {export.Forwarder}");
+                else
+                    Console.WriteLine($"{export.Ordinal} {name} 0x{export.Rva:x}");
+            }
+            return 0;
+        }
+    }
+}
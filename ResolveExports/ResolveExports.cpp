@@ -0,0 +1,164 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+/*
+	Offline export resolver, looks up exported symbols in DLL files on disk and follows forwarders into other DLLs.
+	Replaces starting GetProcAddrHelper once for every symbol, the launcher only needs the RVAs and where the modules are loaded.
+	Built by ResolveExports.vcxproj on windows, elsewhere build it directly:
+		g++ -std=c++17 -O2 -I../H2ToolHooks ResolveExports.cpp ../H2ToolHooks/ExportResolver.cpp ../H2ToolHooks/PEExports.cpp
+			../H2ToolHooks/PEImage.cpp ../H2ToolHooks/MappedFile.cpp -o ResolveExports
+	Every symbol is printed as `<dll>!<symbol>: <implementing dll>+0x<rva>`, or `<dll>!<symbol>: error: <reason>`.
+	A batch file has one `<dll> <symbol>` per line, `#ordinal` looks a symbol up by ordinal.
+*/
+
+#include "ExportResolver.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+static void print_result(const ExportResolver::Request& request, const ExportResolver::Result& result)
+{
+	if (result.is_resolved())
+		printf("%s!%s: %s+0x%x\n", request.module.c_str(), request.symbol.c_str(), result.module.filename().u8string().c_str(), result.rva);
+	else
+		printf("%s!%s: error: %s\n", request.module.c_str(), request.symbol.c_str(), result.error.c_str());
+}
+
+/*
+	Reads `<dll> <symbol>` lines from `path` (`-` for stdin), returns false if it couldn't be read or a line is malformed
+*/
+static bool read_batch_file(const char* path, std::vector<ExportResolver::Request>& requests)
+{
+	std::ifstream file;
+	if (strcmp(path, "-") != 0) {
+		file.open(path);
+		if (!file) {
+			fprintf(stderr, "failed to open %s\n", path);
+			return false;
+		}
+	}
+	std::istream& input = strcmp(path, "-") != 0 ? file : std::cin;
+
+	std::string line;
+	for (size_t line_number = 1; std::getline(input, line); line_number++) {
+		const size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#')
+			continue;
+
+		char module[0x200], symbol[0x200], extra;
+		if (sscanf(line.c_str(), " %511s %511s %c", module, symbol, &extra) != 2) {
+			fprintf(stderr, "%s:%zu: expected '<dll> <symbol>'\n", path, line_number);
+			return false;
+		}
+		requests.push_back({ module, symbol });
+	}
+	return true;
+}
+
+static void list_exports(const PEExports& exports)
+{
+	printf("module: %.*s\n", static_cast<int>(exports.module_name.size()), exports.module_name.data());
+	printf("ordinal_base: %u\n", exports.ordinal_base);
+	for (const auto& entry : exports.get_exports()) {
+		const std::string_view name = entry.name.empty() ? std::string_view("(ordinal only)") : entry.name;
+		if (entry.forwarder.empty())
+			printf("%u %.*s 0x%x\n", entry.ordinal, static_cast<int>(name.size()), name.data(), entry.rva);
+		else
+			printf("%u %.*s -> %.*s\n", entry.ordinal, static_cast<int>(name.size()), name.data(),
+				static_cast<int>(entry.forwarder.size()), entry.forwarder.data());
+	}
+}
+
+static void print_usage(const char* program)
+{
+	fprintf(stderr,
+		"usage: %s [options] <dll> <symbol>...\n"
+		"       %s [options] --batch <file|->\n"
+		"       %s [options] --list <dll>\n"
+		"  --search <directory>     where to look for DLLs given by name and the ones forwarded to, can be repeated\n"
+		"  --batch <file|->         resolve every '<dll> <symbol>' line in the file, or stdin\n"
+		"  --list <dll>             print every export of the DLL\n"
+		"  --time                   print how long resolving took\n",
+		program, program, program);
+}
+
+// ResolveExports [options] <dll> <symbol>..., exits with 1 if a symbol couldn't be resolved
+int main(int argc, char* argv[])
+{
+	std::vector<std::filesystem::path> search_paths;
+	std::vector<ExportResolver::Request> requests;
+	const char* batch_path = nullptr;
+	const char* list_module = nullptr;
+	bool is_timed = false;
+	std::vector<const char*> positional;
+	for (int i = 1; i < argc; i++) {
+		const std::string argument = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (argument == "--search" && has_value) {
+			search_paths.push_back(std::filesystem::u8path(argv[++i]));
+		}
+		else if (argument == "--batch" && has_value) {
+			batch_path = argv[++i];
+		}
+		else if (argument == "--list" && has_value) {
+			list_module = argv[++i];
+		}
+		else if (argument == "--time") {
+			is_timed = true;
+		}
+		else if (argument.size() > 1 && argument.compare(0, 2, "--") == 0) {
+			print_usage(argv[0]);
+			return 2;
+		}
+		else {
+			positional.push_back(argv[i]);
+		}
+	}
+
+	ExportResolver resolver(search_paths);
+	if (list_module) {
+		std::string error;
+		const PEExports* exports = resolver.get_exports(list_module, &error);
+		if (!exports) {
+			fprintf(stderr, "%s\n", error.c_str());
+			return 2;
+		}
+		list_exports(*exports);
+		return 0;
+	}
+
+	if (batch_path) {
+		if (!positional.empty() || !read_batch_file(batch_path, requests)) {
+			print_usage(argv[0]);
+			return 2;
+		}
+	}
+	else {
+		if (positional.size() < 2) {
+			print_usage(argv[0]);
+			return 2;
+		}
+		for (size_t i = 1; i < positional.size(); i++)
+			requests.push_back({ positional[0], positional[i] });
+	}
+
+	const auto start_time = std::chrono::steady_clock::now();
+	const auto results = resolver.resolve_batch(requests);
+	const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time);
+
+	bool is_resolved = true;
+	for (size_t i = 0; i < requests.size(); i++) {
+		print_result(requests[i], results[i]);
+		is_resolved = results[i].is_resolved() && is_resolved;
+	}
+	if (is_timed)
+		printf("resolve_time_ms: %.3f\n", elapsed.count());
+
+	return is_resolved ? 0 : 1;
+}
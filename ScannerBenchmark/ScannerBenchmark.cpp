@@ -0,0 +1,1531 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+/*
+	Benchmarks the H2ToolHooks signatures against synthetic images with planted matches, a real executable or section dumps.
+	Every result is printed as one JSON object per line so runs can be compared by scripts.
+	With --verify nothing is timed, the scans are checked against trying the patterns at every address instead. Build it with
+	-mavx2 and with -DANCHOR_PREFILTER_SCALAR as well to check every prefilter search loop.
+	Built by ScannerBenchmark.vcxproj on windows, elsewhere build it directly:
+		g++ -std=c++17 -O2 -I../H2ToolHooks ScannerBenchmark.cpp ../H2ToolHooks/PatternScanner.cpp ../H2ToolHooks/PEImage.cpp
+			../H2ToolHooks/MappedFile.cpp ../H2ToolHooks/AnchorPrefilter.cpp ../H2ToolHooks/BytecodePattern.cpp
+			../H2ToolHooks/ScanStats.cpp ../H2ToolHooks/InstructionLength.cpp ../H2ToolHooks/Logger.cpp
+			../H2ToolHooks/PatchTransaction.cpp -pthread -o ScannerBenchmark
+*/
+
+#include "AnchorPrefilter.h"
+#include "BytecodePattern.h"
+#include "InstructionLength.h"
+#include "PatternScanner.h"
+#include "PEImage.h"
+#include "MappedFile.h"
+#include "PatchTransaction.h"
+#include "Signatures.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include "platform.h"
+#else
+#include <sys/mman.h>
+#endif
+
+constexpr static uint32_t synthetic_image_base = 0x400000;
+constexpr static uint64_t synthetic_x64_image_base = 0x140000000;
+constexpr static uint32_t synthetic_section_alignment = 0x1000;
+constexpr static uint32_t synthetic_rdata_size = 0x100000;
+
+struct SectionDump
+{
+	std::string path;
+	uint32_t rva;
+	bool is_code;
+};
+
+struct Options
+{
+	size_t code_size = 32 * 1024 * 1024;
+	size_t assert_count = 2000;
+	size_t iterations = 5;
+	size_t thread_count = 0;
+	uint32_t seed = 0x4F534F59;
+	bool relocations = true;
+	bool duplicate_strings = false;
+	bool x64 = false;
+	std::string executable;
+	uint32_t dump_image_base = synthetic_image_base;
+	std::vector<SectionDump> dumps;
+};
+
+/*
+	xorshift32, the synthetic images need to be identical between runs and platforms
+*/
+class Random
+{
+public:
+	explicit Random(uint32_t seed) : state(seed ? seed : 1) {}
+
+	uint32_t next() {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	uint32_t below(uint32_t limit) {
+		return next() % limit;
+	}
+
+private:
+	uint32_t state;
+};
+
+/*
+	A 32 or 64-bit image laid out as if it was loaded, built in memory.
+	Sections are added at increasing addresses and the headers are written once all of them are known.
+*/
+class ImageBuilder
+{
+public:
+	explicit ImageBuilder(uint64_t image_base, bool is_64bit = false) :
+		image_base(image_base),
+		is_64bit(is_64bit),
+		image(synthetic_section_alignment)
+	{}
+
+	uint32_t add_section(const char* name, size_t size, uint32_t characteristics, uint32_t rva = 0) {
+		if (rva == 0)
+			rva = static_cast<uint32_t>(image.size());
+		const size_t end = align(size_t(rva) + size);
+		if (end > image.size())
+			image.resize(end);
+		sections.push_back({ name, rva, static_cast<uint32_t>(size), characteristics });
+		return rva;
+	}
+
+	/*
+		Records an absolute address at `rva` for the base relocations
+	*/
+	void add_relocation(uint32_t rva) {
+		relocations.push_back(rva);
+	}
+
+	/*
+		Like linking with /FIXED, the image can then only be loaded at its preferred base
+	*/
+	void strip_relocations() {
+		relocations.clear();
+	}
+
+	uint8_t* at(uint32_t rva) {
+		return image.data() + rva;
+	}
+
+	uint64_t address_of(uint32_t rva) const {
+		return image_base + rva;
+	}
+
+	const std::vector<uint8_t>& finish(uint32_t timestamp) {
+		const uint32_t relocation_rva = relocations.empty() ? 0 : add_relocation_section();
+
+		const size_t nt_offset = 0x80;
+		const size_t file_header = nt_offset + 4;
+		const size_t optional_header = file_header + 20;
+		const size_t optional_header_size = is_64bit ? 240 : 224;
+		const size_t section_headers = optional_header + optional_header_size;
+		// the directories follow the 64-bit fields that grew
+		const size_t directories = optional_header + (is_64bit ? 112 : 96);
+
+		write<uint16_t>(0, 0x5A4D); // MZ
+		write<uint32_t>(0x3C, nt_offset);
+		write<uint32_t>(nt_offset, 0x4550); // PE\0\0
+		write<uint16_t>(file_header, is_64bit ? 0x8664 : 0x14C); // AMD64 or i386
+		write<uint16_t>(file_header + 2, static_cast<uint16_t>(sections.size()));
+		write<uint32_t>(file_header + 4, timestamp);
+		write<uint16_t>(file_header + 16, static_cast<uint16_t>(optional_header_size));
+		write<uint16_t>(file_header + 18, is_64bit ? 0x22 : 0x102); // executable, large address aware or 32-bit
+		write<uint16_t>(optional_header, is_64bit ? 0x20B : 0x10B);
+		if (is_64bit)
+			write<uint64_t>(optional_header + 24, image_base);
+		else
+			write<uint32_t>(optional_header + 28, static_cast<uint32_t>(image_base));
+		write<uint32_t>(optional_header + 32, synthetic_section_alignment);
+		write<uint32_t>(optional_header + 56, static_cast<uint32_t>(image.size()));
+		write<uint32_t>(directories - 4, 16);
+		if (relocation_rva) {
+			write<uint32_t>(directories + PEImage::directory_base_relocation * 8, relocation_rva);
+			write<uint32_t>(directories + 4 + PEImage::directory_base_relocation * 8, sections.back().size);
+		}
+
+		for (size_t i = 0; i < sections.size(); i++) {
+			const size_t header = section_headers + i * 40;
+			memcpy(image.data() + header, sections[i].name, std::min<size_t>(strlen(sections[i].name), 8));
+			write<uint32_t>(header + 8, sections[i].size);
+			write<uint32_t>(header + 12, sections[i].rva);
+			write<uint32_t>(header + 16, sections[i].size);
+			write<uint32_t>(header + 20, sections[i].rva);
+			write<uint32_t>(header + 36, sections[i].characteristics);
+		}
+
+		return image;
+	}
+
+private:
+	/*
+		Writes the relocations as one block per page of HIGHLOW (or DIR64) entries
+	*/
+	uint32_t add_relocation_section() {
+		std::sort(relocations.begin(), relocations.end());
+		std::vector<uint8_t> blocks;
+		auto append = [&blocks](auto value) {
+			const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+			blocks.insert(blocks.end(), bytes, bytes + sizeof(value));
+		};
+
+		for (size_t first = 0; first < relocations.size();) {
+			const uint32_t page = relocations[first] & ~0xFFFu;
+			size_t last = first;
+			while (last < relocations.size() && (relocations[last] & ~0xFFFu) == page)
+				last++;
+
+			// blocks are padded to 32 bits with an entry that does nothing
+			const size_t entry_count = (last - first + 1) & ~size_t(1);
+			append(page);
+			append(static_cast<uint32_t>(8 + entry_count * 2));
+			for (size_t i = first; i < last; i++)
+				append(static_cast<uint16_t>(((is_64bit ? PEImage::relocation_dir64 : PEImage::relocation_highlow) << 12) | (relocations[i] & 0xFFF)));
+			if (entry_count != last - first)
+				append(uint16_t(0));
+			first = last;
+		}
+
+		// discardable, readable
+		const uint32_t rva = add_section(".reloc", blocks.size(), 0x02000000 | PEImage::section_readable);
+		memcpy(at(rva), blocks.data(), blocks.size());
+		return rva;
+	}
+
+	struct SectionInfo
+	{
+		const char* name;
+		uint32_t rva;
+		uint32_t size;
+		uint32_t characteristics;
+	};
+
+	static size_t align(size_t value) {
+		return (value + synthetic_section_alignment - 1) & ~size_t(synthetic_section_alignment - 1);
+	}
+
+	template <typename T>
+	void write(size_t offset, T value) {
+		memcpy(image.data() + offset, &value, sizeof(T));
+	}
+
+	uint64_t image_base;
+	bool is_64bit;
+	std::vector<uint8_t> image;
+	std::vector<SectionInfo> sections;
+	std::vector<uint32_t> relocations;
+};
+
+/*
+	Fills `code` with a stream of common x86 instruction encodings so the byte frequencies are close to real code
+*/
+static void fill_x86_like(ImageBuilder& builder, uint32_t rva, size_t size, Random& random)
+{
+	uint8_t* code = builder.at(rva);
+	const uint32_t code_address = static_cast<uint32_t>(builder.address_of(rva));
+	size_t position = 0;
+	auto put = [&](std::initializer_list<uint8_t> bytes) {
+		for (uint8_t byte : bytes)
+			if (position < size)
+				code[position++] = byte;
+	};
+	auto put_u32 = [&](uint32_t value) {
+		put({ uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) });
+	};
+	auto put_pointer = [&](uint32_t value) {
+		if (position + sizeof(value) <= size)
+			builder.add_relocation(rva + static_cast<uint32_t>(position));
+		put_u32(value);
+	};
+
+	while (position < size) {
+		const uint32_t kind = random.below(16);
+		switch (kind) {
+		case 0: // function padding and prologue
+			while (position < size && (position & 0xF) != 0)
+				put({ 0xCC });
+			put({ 0x55, 0x8B, 0xEC }); // push ebp, mov ebp, esp
+			break;
+		case 1: // call somewhere else in the code
+			put({ 0xE8 });
+			put_u32(static_cast<uint32_t>(random.below(static_cast<uint32_t>(size)) & ~0xFu) - static_cast<uint32_t>(position + 4));
+			break;
+		case 2: // push imm32
+			put({ 0x68 });
+			if (random.below(2))
+				put_pointer(code_address + random.below(static_cast<uint32_t>(size)));
+			else
+				put_u32(random.below(0x10000));
+			break;
+		case 3: // push imm8
+			put({ 0x6A, uint8_t(random.below(4)) });
+			break;
+		case 4: // add esp, imm8
+			put({ 0x83, 0xC4, uint8_t(random.below(8) * 4) });
+			break;
+		case 5: // mov eax, [ebp + disp8]
+			put({ 0x8B, 0x45, uint8_t(random.next()) });
+			break;
+		case 6: // mov [ebp + disp8], eax
+			put({ 0x89, 0x45, uint8_t(random.next()) });
+			break;
+		case 7: // xor eax, eax / test eax, eax
+			put({ random.below(2) ? uint8_t(0x33) : uint8_t(0x85), 0xC0 });
+			break;
+		case 8: // jcc rel8
+			put({ uint8_t(0x70 + random.below(16)), uint8_t(random.next()) });
+			break;
+		case 9: // mov reg, imm32
+			put({ uint8_t(0xB8 + random.below(8)) });
+			put_u32(random.below(0x1000));
+			break;
+		case 10: // epilogue
+			put({ 0x8B, 0xE5, 0x5D, 0xC3 }); // mov esp, ebp, pop ebp, ret
+			break;
+		case 11: // a near miss for the assert signatures, push 1 followed by more pushes
+			put({ 0x6A, 0x01, 0x68 });
+			put_u32(random.below(0x10000));
+			put({ 0x68 });
+			put_pointer(code_address + random.below(static_cast<uint32_t>(size)));
+			break;
+		default: // anything else
+			put({ uint8_t(random.next()) });
+			break;
+		}
+	}
+}
+
+struct Image
+{
+	std::string name;
+	std::unique_ptr<MappedFile> file;
+	std::vector<uint8_t> storage;
+	std::optional<PEImage> pe;
+	// planted signatures, -1 if unknown
+	long long expected_hs_assert = -1;
+	long long expected_assert_sites = -1;
+	long long expected_cuban = -1;
+};
+
+/*
+	Puts int3 padding in front of a planted site like the padding between functions, so a sweep of the instructions
+	in the filler before it is back in step by the time it gets to the site
+*/
+static void pad_before_site(ImageBuilder& builder, uint32_t rva)
+{
+	memset(builder.at(rva - 0x10), 0xCC, 0x10);
+}
+
+static void write_assert_site(ImageBuilder& builder, uint32_t rva, uint32_t line, uint32_t message,
+	uint32_t display_assert, uint32_t system_debugger_present)
+{
+	const uint32_t site_address = static_cast<uint32_t>(builder.address_of(rva));
+	const uint32_t call_display = display_assert - (site_address + 17 + 5);
+	const uint32_t call_debugger = system_debugger_present - (site_address + 25 + 5);
+	const uint8_t bytes[30] = {
+		0x6A, 0x01,
+		0x68, uint8_t(line), uint8_t(line >> 8), uint8_t(line >> 16), uint8_t(line >> 24),
+		0x68, 0x00, 0x10, 0x40, 0x00,
+		0x68, uint8_t(message), uint8_t(message >> 8), uint8_t(message >> 16), uint8_t(message >> 24),
+		0xE8, uint8_t(call_display), uint8_t(call_display >> 8), uint8_t(call_display >> 16), uint8_t(call_display >> 24),
+		0x83, 0xC4, 0x10,
+		0xE8, uint8_t(call_debugger), uint8_t(call_debugger >> 8), uint8_t(call_debugger >> 16), uint8_t(call_debugger >> 24),
+	};
+	memcpy(builder.at(rva), bytes, sizeof(bytes));
+	pad_before_site(builder, rva);
+	// c_filename and c_assertion_message
+	builder.add_relocation(rva + 8);
+	builder.add_relocation(rva + 13);
+}
+
+/*
+	A code and rdata section filled with x86-like bytes, with hs_assert, `assert_count` other assert sites and the cuban
+	lightmap settings planted at random addresses.
+*/
+static Image build_synthetic_image(const Options& options)
+{
+	Random random(options.seed);
+	ImageBuilder builder(synthetic_image_base);
+
+	const size_t code_size = std::max<size_t>(options.code_size, 0x10000);
+	const uint32_t text = builder.add_section(".text", code_size, PEImage::section_code | PEImage::section_executable | PEImage::section_readable);
+	const uint32_t rdata = builder.add_section(".rdata", synthetic_rdata_size, PEImage::section_readable);
+	builder.add_section(".data", 0x10000, PEImage::section_readable | PEImage::section_writable);
+
+	fill_x86_like(builder, text, code_size, random);
+
+	// printable filler with a string every so often, like the string tables in rdata
+	uint8_t* rdata_data = builder.at(rdata);
+	for (size_t i = 0; i < synthetic_rdata_size; i++)
+		rdata_data[i] = random.below(8) == 0 ? 0 : uint8_t(' ' + random.below(95));
+
+	auto put_string = [&](uint32_t offset, const char* string) {
+		memcpy(rdata_data + offset, string, strlen(string) + 1);
+		return static_cast<uint32_t>(builder.address_of(rdata + offset));
+	};
+	const uint32_t hs_assert_string = put_string(0x800, "hs_type_valid(definition->return_type)");
+	const uint32_t cuban_string = put_string(0x1000, "cuban");
+	// unreferenced copies, so the string references can't be used as literals
+	if (options.duplicate_strings) {
+		put_string(0x3000, "hs_type_valid(definition->return_type)");
+		put_string(0x3800, "cuban");
+	}
+
+	const uint32_t cuban_settings[8] = { cuban_string, 1, 1, 0, 50000, 0, 0x3F800000 /* 1.0f */, 0 };
+	memcpy(rdata_data + 0x2000, cuban_settings, sizeof(cuban_settings));
+	builder.add_relocation(rdata + 0x2000);
+
+	// the functions called by asserts, placed at function boundaries
+	const uint32_t display_assert = static_cast<uint32_t>(builder.address_of(text + 0x100));
+	const uint32_t system_debugger_present = static_cast<uint32_t>(builder.address_of(text + 0x200));
+
+	// sites are 0x40 aligned so they can't overlap, hs_assert is in the first slot
+	const size_t site_slots = code_size / 0x40 - 0x10;
+	std::vector<bool> used(site_slots);
+	auto pick_slot = [&]() {
+		for (;;) {
+			const size_t slot = 0x10 + random.below(static_cast<uint32_t>(site_slots - 0x10));
+			if (!used[slot]) {
+				used[slot] = true;
+				return slot;
+			}
+		}
+	};
+
+	const uint32_t hs_assert_rva = text + static_cast<uint32_t>(pick_slot() * 0x40);
+	write_assert_site(builder, hs_assert_rva, 2960, hs_assert_string,
+		display_assert, system_debugger_present);
+	// push -1, call system_exit
+	const uint8_t exit_call[] = { 0x6A, 0xFF, 0xE8, 0x00, 0x00, 0x00, 0x00 };
+	memcpy(builder.at(hs_assert_rva + 30), exit_call, sizeof(exit_call));
+
+	const size_t assert_count = std::min(options.assert_count, site_slots / 2);
+	for (size_t i = 0; i < assert_count; i++) {
+		const uint32_t site = text + static_cast<uint32_t>(pick_slot() * 0x40);
+		write_assert_site(builder, site, random.below(5000), static_cast<uint32_t>(builder.address_of(rdata + random.below(synthetic_rdata_size))),
+			display_assert, system_debugger_present);
+	}
+
+	if (!options.relocations)
+		builder.strip_relocations();
+
+	Image image;
+	image.name = "synthetic";
+	if (!options.relocations)
+		image.name += "_without_relocations";
+	if (options.duplicate_strings)
+		image.name += "_duplicate_strings";
+	image.storage = builder.finish(options.seed);
+	image.pe = PEImage::parse(image.storage.data(), image.storage.size(), true);
+	image.expected_hs_assert = 1;
+	// hs_assert is an assert site too
+	image.expected_assert_sites = static_cast<long long>(assert_count) + 1;
+	image.expected_cuban = 1;
+	return image;
+}
+
+/*
+	An x64 assert site: mov r8d, line; lea rdx, [rip+file]; lea rcx, [rip+message]; call display_assert
+*/
+static void write_x64_assert_site(ImageBuilder& builder, uint32_t rva, uint32_t line, uint64_t file, uint64_t message, uint64_t display_assert)
+{
+	const uint64_t site_address = builder.address_of(rva);
+	// each displacement is relative to the end of its instruction
+	const uint32_t file_displacement = static_cast<uint32_t>(file - (site_address + 13));
+	const uint32_t message_displacement = static_cast<uint32_t>(message - (site_address + 20));
+	const uint32_t call_display = static_cast<uint32_t>(display_assert - (site_address + 25));
+	const uint8_t bytes[25] = {
+		0x41, 0xB8, uint8_t(line), uint8_t(line >> 8), uint8_t(line >> 16), uint8_t(line >> 24),
+		0x48, 0x8D, 0x15, uint8_t(file_displacement), uint8_t(file_displacement >> 8), uint8_t(file_displacement >> 16), uint8_t(file_displacement >> 24),
+		0x48, 0x8D, 0x0D, uint8_t(message_displacement), uint8_t(message_displacement >> 8), uint8_t(message_displacement >> 16), uint8_t(message_displacement >> 24),
+		0xE8, uint8_t(call_display), uint8_t(call_display >> 8), uint8_t(call_display >> 16), uint8_t(call_display >> 24),
+	};
+	memcpy(builder.at(rva), bytes, sizeof(bytes));
+	pad_before_site(builder, rva);
+}
+
+/*
+	The 64-bit version of the synthetic image, based above 4GB with the assert sites written as x64 code.
+	hs_assert references its message with a RIP-relative lea instead of an absolute push.
+*/
+static Image build_synthetic_x64_image(const Options& options)
+{
+	Random random(options.seed);
+	ImageBuilder builder(synthetic_x64_image_base, true);
+
+	const size_t code_size = std::max<size_t>(options.code_size, 0x10000);
+	const uint32_t text = builder.add_section(".text", code_size, PEImage::section_code | PEImage::section_executable | PEImage::section_readable);
+	const uint32_t rdata = builder.add_section(".rdata", synthetic_rdata_size, PEImage::section_readable);
+	builder.add_section(".data", 0x10000, PEImage::section_readable | PEImage::section_writable);
+
+	// close enough for byte frequencies, but its 32-bit pointers don't mean anything here
+	fill_x86_like(builder, text, code_size, random);
+	builder.strip_relocations();
+
+	uint8_t* rdata_data = builder.at(rdata);
+	for (size_t i = 0; i < synthetic_rdata_size; i++)
+		rdata_data[i] = random.below(8) == 0 ? 0 : uint8_t(' ' + random.below(95));
+	auto put_string = [&](uint32_t offset, const char* string) {
+		memcpy(rdata_data + offset, string, strlen(string) + 1);
+		return builder.address_of(rdata + offset);
+	};
+	const uint64_t file_string = put_string(0x400, "c:\\halo\\source\\hs\\hs_compile.cpp");
+	const uint64_t hs_assert_string = put_string(0x800, "hs_type_valid(definition->return_type)");
+	if (options.duplicate_strings)
+		put_string(0x3000, "hs_type_valid(definition->return_type)");
+
+	const uint64_t display_assert = builder.address_of(text + 0x100);
+
+	const size_t site_slots = code_size / 0x40 - 0x10;
+	std::vector<bool> used(site_slots);
+	auto pick_slot = [&]() {
+		for (;;) {
+			const size_t slot = 0x10 + random.below(static_cast<uint32_t>(site_slots - 0x10));
+			if (!used[slot]) {
+				used[slot] = true;
+				return slot;
+			}
+		}
+	};
+
+	write_x64_assert_site(builder, text + static_cast<uint32_t>(pick_slot() * 0x40), 2960, file_string, hs_assert_string, display_assert);
+	const size_t assert_count = std::min(options.assert_count, site_slots / 2);
+	for (size_t i = 0; i < assert_count; i++) {
+		write_x64_assert_site(builder, text + static_cast<uint32_t>(pick_slot() * 0x40), random.below(5000), file_string,
+			builder.address_of(rdata + random.below(synthetic_rdata_size)), display_assert);
+	}
+
+	Image image;
+	image.name = "synthetic_x64";
+	if (options.duplicate_strings)
+		image.name += "_duplicate_strings";
+	image.storage = builder.finish(options.seed);
+	image.pe = PEImage::parse(image.storage.data(), image.storage.size(), true);
+	image.expected_hs_assert = 1;
+	image.expected_assert_sites = static_cast<long long>(assert_count) + 1;
+	return image;
+}
+
+/*
+	Places raw section dumps at their original addresses so the absolute addresses in them still resolve
+*/
+static std::optional<Image> build_dump_image(const Options& options)
+{
+	ImageBuilder builder(options.dump_image_base);
+	std::string name;
+	for (const auto& dump : options.dumps) {
+		MappedFile file(dump.path);
+		if (!file.is_open()) {
+			fprintf(stderr, "Failed to open %s\n", dump.path.c_str());
+			return std::optional<Image>{};
+		}
+		const uint32_t characteristics = dump.is_code
+			? PEImage::section_code | PEImage::section_executable | PEImage::section_readable
+			: PEImage::section_readable;
+		const uint32_t rva = builder.add_section(dump.is_code ? ".text" : ".rdata", file.size(), characteristics, dump.rva);
+		memcpy(builder.at(rva), file.data(), file.size());
+
+		if (!name.empty())
+			name += '+';
+		name += dump.path;
+	}
+
+	Image image;
+	image.name = name;
+	image.storage = builder.finish(0);
+	image.pe = PEImage::parse(image.storage.data(), image.storage.size(), true);
+	return image;
+}
+
+static std::optional<Image> load_executable(const std::string& path)
+{
+	Image image;
+	image.name = path;
+	image.file = std::make_unique<MappedFile>(path);
+	if (!image.file->is_open()) {
+		fprintf(stderr, "Failed to open %s\n", path.c_str());
+		return std::optional<Image>{};
+	}
+	image.pe = PEImage::parse(image.file->data(), image.file->size(), false);
+	if (!image.pe) {
+		fprintf(stderr, "%s is not a PE image\n", path.c_str());
+		return std::optional<Image>{};
+	}
+	return image;
+}
+
+static size_t section_bytes(const PEImage& pe, uint32_t required, uint32_t excluded)
+{
+	size_t bytes = 0;
+	for (const auto& section : pe.get_sections()) {
+		if ((section.characteristics & required) == required && (section.characteristics & excluded) == 0)
+			bytes += pe.section_data_size(section);
+	}
+	return bytes;
+}
+
+static void escape_json(const std::string& string, std::string& out)
+{
+	for (char character : string) {
+		if (character == '"' || character == '\\')
+			out += '\\';
+		if (static_cast<unsigned char>(character) < 0x20)
+			continue;
+		out += character;
+	}
+}
+
+struct BenchmarkResult
+{
+	double median_ms;
+	size_t matches;
+};
+
+/*
+	Runs `benchmark` for each iteration and prints the timings, returns false if the match count isn't what was planted.
+	`benchmark` is given a fresh scanner every time so the lazily built indexes are part of what's measured.
+	`operations` is only set for the microbenchmarks, which also report the time per operation.
+	The median and the match count are also put in `result` if there is one, for benchmarks compared against each other.
+*/
+static bool run_benchmark(const Image& image, const Options& options, const char* name, size_t bytes, long long expected,
+	const std::function<size_t(const PatternScanner&)>& benchmark, size_t operations = 0, BenchmarkResult* result = nullptr)
+{
+	std::vector<double> times;
+	size_t matches = 0;
+	for (size_t i = 0; i < options.iterations; i++) {
+		const PatternScanner scanner(*image.pe);
+		const auto start_time = std::chrono::steady_clock::now();
+		matches = benchmark(scanner);
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count());
+	}
+	std::sort(times.begin(), times.end());
+	const double median = times[times.size() / 2];
+	const double mb_per_second = median > 0 ? (bytes / (1024.0 * 1024.0)) / (median / 1000.0) : 0;
+	const double ns_per_operation = operations > 0 ? median * 1000000.0 / operations : 0;
+	const bool is_ok = expected < 0 || matches == static_cast<size_t>(expected);
+
+	std::string image_name;
+	escape_json(image.name, image_name);
+	printf("{\"image\":\"%s\",\"benchmark\":\"%s\",\"bytes\":%zu,\"iterations\":%zu,\"min_ms\":%.3f,\"median_ms\":%.3f,\"max_ms\":%.3f,"
+		"\"mb_per_s\":%.1f,\"ns_per_op\":%.3f,\"matches\":%zu,\"expected\":%lld,\"ok\":%s}\n",
+		image_name.c_str(), name, bytes, times.size(), times.front(), median, times.back(),
+		mb_per_second, ns_per_operation, matches, expected, is_ok ? "true" : "false");
+	fflush(stdout);
+	if (result)
+		*result = { median, matches };
+	return is_ok;
+}
+
+/*
+	Scans all of the code with 1, 2, 4... threads up to the number of cores and reports the speedup over one thread.
+	Every run has to find the same matches as the single threaded one, a chunk boundary bug shows up as a different count.
+*/
+template <typename Pattern>
+static bool run_thread_sweep(const Image& image, const Options& options, const char* name, const Pattern& pattern, size_t bytes)
+{
+	const size_t core_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	std::vector<size_t> thread_counts;
+	for (size_t thread_count = 1; thread_count < core_count; thread_count *= 2)
+		thread_counts.push_back(thread_count);
+	thread_counts.push_back(core_count);
+
+	std::string image_name;
+	escape_json(image.name, image_name);
+	bool is_ok = true;
+	BenchmarkResult single_thread = {};
+	for (const size_t thread_count : thread_counts) {
+		const std::string benchmark_name = std::string(name) + "_threads_" + std::to_string(thread_count);
+		BenchmarkResult result = {};
+		const long long expected = thread_count == 1 ? -1 : static_cast<long long>(single_thread.matches);
+		is_ok = run_benchmark(image, options, benchmark_name.c_str(), bytes, expected, [&](const PatternScanner& scanner) {
+			return scanner.find_pattern_in_code_multiple_parallel(pattern, 0, thread_count).size();
+		}, 0, &result) && is_ok;
+		if (thread_count == 1)
+			single_thread = result;
+
+		printf("{\"image\":\"%s\",\"benchmark\":\"%s_thread_sweep\",\"threads\":%zu,\"median_ms\":%.3f,\"speedup\":%.2f}\n",
+			image_name.c_str(), name, thread_count, result.median_ms, result.median_ms > 0 ? single_thread.median_ms / result.median_ms : 0);
+		fflush(stdout);
+	}
+	return is_ok;
+}
+
+/*
+	Finds the call targets used by assert_pat the same way disable_assertions does
+*/
+static bool find_assert_call_targets(const PatternScanner& scanner, image_address& display_assert, image_address& system_debugger_present)
+{
+	const auto hs_matches = scanner.find_pattern_in_code_multiple(Signatures::hs_assert, 1);
+	if (hs_matches.empty())
+		return false;
+	const image_address hs_assert_call_address = hs_matches[0].offset + hs_matches[0].length;
+	const auto display_assert_target = scanner.get_call_target(hs_assert_call_address);
+	const auto system_debugger_present_target = scanner.get_call_target(hs_assert_call_address + 0x3 + 0x5);
+	if (!display_assert_target || !system_debugger_present_target)
+		return false;
+	display_assert = *display_assert_target;
+	system_debugger_present = *system_debugger_present_target;
+	return true;
+}
+
+/*
+	Finds hs_assert and the assert sites in one walk over the code like disable_assertions, returns the number of sites if hs_assert was found
+*/
+static std::optional<size_t> find_asserts_single_pass(const PatternScanner& scanner)
+{
+	const auto [hs_matches, candidates] = scanner.find_patterns_in_code(PatternScanner::search(Signatures::hs_assert, 1), PatternScanner::search(Signatures::assert_candidate_pat));
+	if (hs_matches.empty())
+		return std::optional<size_t>{};
+	const image_address hs_assert_call_address = hs_matches[0].offset + hs_matches[0].length;
+	const auto display_assert = scanner.get_call_target(hs_assert_call_address);
+	const auto system_debugger_present = scanner.get_call_target(hs_assert_call_address + 0x3 + 0x5);
+	if (!display_assert || !system_debugger_present)
+		return std::optional<size_t>{};
+	return static_cast<size_t>(std::count_if(candidates.begin(), candidates.end(), [&](const PatternScanner::Match& candidate) {
+		return Signatures::is_assert_site(scanner, candidate.offset, *display_assert, *system_debugger_present);
+	}));
+}
+
+/*
+	x64 versions of the assert signatures, they only exist to measure the RIP-relative and 64-bit paths
+*/
+constexpr static auto hs_assert_x64 = make_pattern(
+	PAT_BYTES(2, { 0x41, 0xB8 }), PAT_INTEGER_RANGE(uint32_t, 2960 - 400, 2960 + 400), // mov r8d, c_line_number
+	PAT_BYTES(3, { 0x48, 0x8D, 0x15 }), PAT_ANY(4), // lea rdx, c_file_name
+	PAT_BYTES(3, { 0x48, 0x8D, 0x0D }), PAT_RIP_STRING_XREF("hs_type_valid(definition->return_type)") // lea rcx, message
+);
+
+constexpr static char hs_assert_x64_text[] = R"sig(41 B8 [2560..3360] 48 8D 15 ?? ?? ?? ?? 48 8D 0D rip:"hs_type_valid(definition->return_type)")sig";
+
+constexpr static auto assert_x64_pat(image_address display_assert)
+{
+	return make_pattern(
+		PAT_BYTES(3, { 0x48, 0x8D, 0x0D }), PAT_ANY(4), // lea rcx, c_assertion_message
+		PAT_CALL(display_assert)
+	);
+}
+
+/*
+	Zeroed read-only executable pages the size of an image, stand in for the loaded module when benchmarking patches
+*/
+class ProtectedImage
+{
+public:
+	explicit ProtectedImage(size_t size) :
+		size(size)
+	{
+#ifdef _WIN32
+		data = static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READ));
+#else
+		void* mapping = mmap(nullptr, size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		data = mapping != MAP_FAILED ? static_cast<uint8_t*>(mapping) : nullptr;
+#endif
+	}
+
+	~ProtectedImage()
+	{
+#ifdef _WIN32
+		if (data)
+			VirtualFree(data, 0, MEM_RELEASE);
+#else
+		if (data)
+			munmap(data, size);
+#endif
+	}
+
+	uint8_t* data;
+	size_t size;
+};
+
+/*
+	Counts the protection changes made through it
+*/
+class CountingProtection : public MemoryProtection
+{
+public:
+	explicit CountingProtection(MemoryProtection& protection) :
+		protection(protection)
+	{}
+
+	size_t get_page_size() const override {
+		return protection.get_page_size();
+	}
+
+	size_t query(uintptr_t address, uint32_t& page_protection) const override {
+		return protection.query(address, page_protection);
+	}
+
+	bool make_writable(uintptr_t address, size_t size, uint32_t page_protection) override {
+		changes++;
+		return protection.make_writable(address, size, page_protection);
+	}
+
+	bool restore(uintptr_t address, size_t size, uint32_t page_protection) override {
+		changes++;
+		return protection.restore(address, size, page_protection);
+	}
+
+	void flush_instruction_cache(uintptr_t address, size_t size) override {
+		protection.flush_instruction_cache(address, size);
+	}
+
+	size_t changes = 0;
+
+private:
+	MemoryProtection& protection;
+};
+
+static image_address first_code_address(const Image& image)
+{
+	for (const auto& section : image.pe->get_sections()) {
+		if (section.characteristics & PEImage::section_executable)
+			return image.pe->image_base + section.virtual_address;
+	}
+	return image.pe->image_base;
+}
+
+static bool benchmark_x64_image(const Image& image, const Options& options)
+{
+	const size_t code_bytes = section_bytes(*image.pe, PEImage::section_executable, 0);
+	bool is_ok = true;
+
+	is_ok = run_benchmark(image, options, "scanner_setup", 0, -1, [&](const PatternScanner&) {
+		const PatternScanner scanner(*image.pe);
+		return size_t(0);
+	}) && is_ok;
+
+	is_ok = run_benchmark(image, options, "hs_assert_x64", code_bytes, image.expected_hs_assert, [&](const PatternScanner& scanner) {
+		return scanner.find_pattern_in_code_multiple(hs_assert_x64, 1).size();
+	}) && is_ok;
+
+	std::string error;
+	const auto hs_assert_x64_bytecode = BytecodePattern::compile(hs_assert_x64_text, {}, error);
+	is_ok = hs_assert_x64_bytecode && run_benchmark(image, options, "hs_assert_x64_bytecode", code_bytes, image.expected_hs_assert, [&](const PatternScanner& scanner) {
+		return scanner.find_pattern_in_code_multiple(*hs_assert_x64_bytecode, 1).size();
+	}) && is_ok;
+
+	const PatternScanner target_scanner(*image.pe);
+	const auto hs_match = target_scanner.find_pattern_in_code(hs_assert_x64);
+	const auto display_assert = hs_match ? target_scanner.get_call_target(hs_match->offset + hs_match->length) : std::optional<image_address>{};
+	if (!display_assert) {
+		fprintf(stderr, "hs_assert_x64 not found in %s, skipping assert_x64\n", image.name.c_str());
+		return image.expected_assert_sites < 0 && is_ok;
+	}
+
+	const auto assert_site = assert_x64_pat(*display_assert);
+	is_ok = run_benchmark(image, options, "assert_x64", code_bytes, image.expected_assert_sites, [&](const PatternScanner& scanner) {
+		return scanner.find_pattern_in_code_multiple(assert_site).size();
+	}) && is_ok;
+
+	is_ok = run_benchmark(image, options, "assert_x64_boundaries", code_bytes, image.expected_assert_sites, [&](const PatternScanner&) {
+		PatternScanner boundary_scanner(*image.pe);
+		boundary_scanner.set_instruction_boundaries_only(true);
+		return boundary_scanner.find_pattern_in_code_multiple(assert_site).size();
+	}) && is_ok;
+
+	const auto assert_site_bytecode = BytecodePattern::compile("48 8D 0D ?? ?? ?? ?? call:display_assert", { { "display_assert", *display_assert } }, error);
+	is_ok = assert_site_bytecode && run_benchmark(image, options, "assert_x64_bytecode", code_bytes, image.expected_assert_sites, [&](const PatternScanner& scanner) {
+		return scanner.find_pattern_in_code_multiple(*assert_site_bytecode).size();
+	}) && is_ok;
+
+	return is_ok;
+}
+
+static bool benchmark_image(const Image& image, const Options& options)
+{
+	using namespace Signatures;
+
+	const size_t code_bytes = section_bytes(*image.pe, PEImage::section_executable, 0);
+	const size_t rdata_bytes = section_bytes(*image.pe, PEImage::section_readable, PEImage::section_executable | PEImage::section_writable);
+	bool is_ok = true;
+
+	is_ok = run_benchmark(image, options, "scanner_setup", 0, -1, [&](const PatternScanner&) {
+		const PatternScanner scanner(*image.pe);
+		return size_t(0);
+	}) && is_ok;
+
+	is_ok = run_benchmark(image, options, "hs_assert", code_bytes, image.expected_hs_assert, [&](const PatternScanner& scanner) {
+		return scanner.find_pattern_in_code_multiple(hs_assert, 1).size();
+	}) && is_ok;
+
+	// the lazy path, stops at the first match without building a list
+	is_ok = run_benchmark(image, options, "hs_assert_first", code_bytes, image.expected_hs_assert, [&](const PatternScanner& scanner) {
+		return scanner.find_pattern_in_code(hs_assert) ? size_t(1) : size_t(0);
+	}) && is_ok;
+
+	std::string error;
+	const auto hs_assert_bytecode = BytecodePattern::compile(hs_assert_text, {}, error);
+	is_ok = hs_assert_bytecode && run_benchmark(image, options, "hs_assert_bytecode", code_bytes, image.expected_hs_assert, [&](const PatternScanner& scanner) {
+		return scanner.find_pattern_in_code_multiple(*hs_assert_bytecode, 1).size();
+	}) && is_ok;
+
+	is_ok = run_benchmark(image, options, "hs_assert_parallel", code_bytes, image.expected_hs_assert, [&](const PatternScanner& scanner) {
+		return scanner.find_pattern_in_code_multiple_parallel(hs_assert, 1, options.thread_count).size();
+	}) && is_ok;
+
+	// without a match limit every chunk is scanned, which is where more threads can actually help
+	is_ok = run_thread_sweep(image, options, "hs_assert_full", hs_assert, code_bytes) && is_ok;
+
+	// the first lookup only sweeps the block it's in
+	const image_address code_address = first_code_address(image);
+	is_ok = run_benchmark(image, options, "instruction_starts", 0, -1, [&](const PatternScanner& scanner) {
+		return size_t(scanner.is_instruction_start(code_address));
+	}) && is_ok;
+
+	// one lookup in every block sweeps all the code
+	is_ok = run_benchmark(image, options, "instruction_starts_all", code_bytes, -1, [&](const PatternScanner& scanner) {
+		size_t starts = 0;
+		for (const auto& section : image.pe->get_sections()) {
+			if (!(section.characteristics & PEImage::section_executable))
+				continue;
+			for (size_t offset = 0; offset < image.pe->section_data_size(section); offset += 0x1000)
+				starts += scanner.is_instruction_start(image.pe->image_base + section.virtual_address + offset);
+		}
+		return starts;
+	}) && is_ok;
+
+	// what a launch with a warm scan cache does, the cached match is checked where it is
+	const auto hs_assert_match = PatternScanner(*image.pe).find_pattern_in_code(hs_assert);
+	is_ok = hs_assert_match && run_benchmark(image, options, "hs_assert_cached_boundaries", 0, image.expected_hs_assert, [&](const PatternScanner&) {
+		PatternScanner boundary_scanner(*image.pe);
+		boundary_scanner.set_instruction_boundaries_only(true);
+		return boundary_scanner.match_pattern_at_address(hs_assert, hs_assert_match->offset) ? size_t(1) : size_t(0);
+	}) && is_ok;
+
+	// includes the sweep, it's only worth it if the sweep costs less than the candidates it saves
+	is_ok = run_benchmark(image, options, "hs_assert_boundaries", code_bytes, image.expected_hs_assert, [&](const PatternScanner&) {
+		PatternScanner boundary_scanner(*image.pe);
+		boundary_scanner.set_instruction_boundaries_only(true);
+		return boundary_scanner.find_pattern_in_code_multiple(hs_assert, 1).size();
+	}) && is_ok;
+
+	image_address display_assert, system_debugger_present;
+	const PatternScanner target_scanner(*image.pe);
+	if (find_assert_call_targets(target_scanner, display_assert, system_debugger_present)) {
+		const auto assert_site = assert_pat(display_assert, system_debugger_present);
+
+		// the first pattern with a call is scanned for, the call index is only built for the lookups after it
+		is_ok = run_benchmark(image, options, "assert_pat", code_bytes, image.expected_assert_sites, [&](const PatternScanner& scanner) {
+			return scanner.find_pattern_in_code_multiple(assert_site).size();
+		}) && is_ok;
+		is_ok = run_benchmark(image, options, "call_index", code_bytes, -1, [&](const PatternScanner& scanner) {
+			return scanner.get_callers(display_assert).size();
+		}) && is_ok;
+
+		target_scanner.get_callers(display_assert);
+		is_ok = run_benchmark(image, options, "assert_pat_warm", code_bytes, image.expected_assert_sites, [&](const PatternScanner& scanner) {
+			const auto& warm_scanner = target_scanner;
+			return warm_scanner.find_pattern_in_code_multiple(assert_site).size();
+		}) && is_ok;
+
+		const auto assert_site_bytecode = BytecodePattern::compile(assert_pat_text,
+			{ { "display_assert", display_assert }, { "system_debugger_present", system_debugger_present } }, error);
+		is_ok = assert_site_bytecode && run_benchmark(image, options, "assert_pat_bytecode", code_bytes, image.expected_assert_sites, [&](const PatternScanner& scanner) {
+			return scanner.find_pattern_in_code_multiple(*assert_site_bytecode).size();
+		}) && is_ok;
+
+		// disable_assertions on a cold cache, hs_assert and the assert sites found one after the other against both in one walk
+		is_ok = run_benchmark(image, options, "hook_separate_passes", code_bytes, image.expected_assert_sites, [&](const PatternScanner& scanner) {
+			image_address scanned_display_assert, scanned_system_debugger_present;
+			if (!find_assert_call_targets(scanner, scanned_display_assert, scanned_system_debugger_present))
+				return size_t(0);
+			return scanner.find_pattern_in_code_multiple(assert_pat(scanned_display_assert, scanned_system_debugger_present)).size();
+		}) && is_ok;
+		is_ok = run_benchmark(image, options, "hook_single_pass", code_bytes, image.expected_assert_sites, [&](const PatternScanner& scanner) {
+			return find_asserts_single_pass(scanner).value_or(0);
+		}) && is_ok;
+
+		// disable_assertions' writes, a transaction per write the way the old WriteValue helper worked against one for all of them.
+		// Each gets its own pages, on linux the mappings split by patching one page at a time don't always merge again.
+		const auto sites = target_scanner.find_pattern_in_code_multiple(assert_site);
+		auto patch_sites = [&](const ProtectedImage& patch_target, bool is_batched) {
+			CountingProtection protection(MemoryProtection::current_process());
+			PatchTransaction batch(protection);
+			for (const auto& site : sites) {
+				PatchTransaction single(protection);
+				PatchTransaction& patches = is_batched ? batch : single;
+				patches.write_value<uint8_t>(reinterpret_cast<uintptr_t>(patch_target.data) + static_cast<size_t>(site.offset + 1 - image.pe->image_base), 0x00);
+				single.commit();
+			}
+			batch.commit();
+			// the number of protection changes, not matches
+			return protection.changes;
+		};
+		const ProtectedImage batched_target(image.pe->image_size);
+		is_ok = batched_target.data && run_benchmark(image, options, "patch_batched", 0, -1, [&](const PatternScanner&) {
+			return patch_sites(batched_target, true);
+		}, sites.size()) && is_ok;
+		const ProtectedImage each_target(image.pe->image_size);
+		is_ok = each_target.data && run_benchmark(image, options, "patch_each", 0, -1, [&](const PatternScanner&) {
+			return patch_sites(each_target, false);
+		}, sites.size()) && is_ok;
+
+		// the check the hooks make when the DLL is unloaded, then undoing the same patches
+		auto site_address = [&](const ProtectedImage& patch_target, const PatternScanner::Match& site) {
+			return reinterpret_cast<uintptr_t>(patch_target.data) + static_cast<size_t>(site.offset + 1 - image.pe->image_base);
+		};
+		const ProtectedImage journal_target(image.pe->image_size);
+		if (journal_target.data) {
+			PatchTransaction journal;
+			for (const auto& site : sites)
+				journal.write_value<uint8_t>(site_address(journal_target, site), 0xCC);
+			is_ok = journal.commit() && run_benchmark(image, options, "patch_verify", 0, 1, [&](const PatternScanner&) {
+				return size_t(journal.verify());
+			}, sites.size()) && is_ok;
+			journal.rollback();
+		}
+
+		// the matches are the sites still patched after rolling back
+		is_ok = journal_target.data && run_benchmark(image, options, "patch_rollback", 0, 0, [&](const PatternScanner&) {
+			PatchTransaction journal;
+			for (const auto& site : sites)
+				journal.write_value<uint8_t>(site_address(journal_target, site), 0xCC);
+			journal.commit();
+			journal.rollback();
+			return static_cast<size_t>(std::count_if(sites.begin(), sites.end(), [&](const PatternScanner::Match& site) {
+				return *reinterpret_cast<const uint8_t*>(site_address(journal_target, site)) != 0;
+			}));
+		}, sites.size()) && is_ok;
+
+		is_ok = run_benchmark(image, options, "assert_pat_boundaries", code_bytes, image.expected_assert_sites, [&](const PatternScanner&) {
+			PatternScanner boundary_scanner(*image.pe);
+			boundary_scanner.set_instruction_boundaries_only(true);
+			return boundary_scanner.find_pattern_in_code_multiple(assert_site).size();
+		}) && is_ok;
+	}
+	else {
+		fprintf(stderr, "hs_assert not found in %s, skipping assert_pat\n", image.name.c_str());
+		is_ok = image.expected_assert_sites < 0 && is_ok;
+	}
+
+	is_ok = run_benchmark(image, options, "cuban_lightmap_setting", rdata_bytes, image.expected_cuban, [&](const PatternScanner& scanner) {
+		return scanner.find_pattern_in_rdata(cuban_lightmap_setting) ? size_t(1) : size_t(0);
+	}) && is_ok;
+
+	const auto cuban_lightmap_setting_bytecode = BytecodePattern::compile(cuban_lightmap_setting_text, {}, error);
+	is_ok = cuban_lightmap_setting_bytecode && run_benchmark(image, options, "cuban_lightmap_setting_bytecode", rdata_bytes, image.expected_cuban, [&](const PatternScanner& scanner) {
+		return scanner.find_pattern_in_rdata(*cuban_lightmap_setting_bytecode) ? size_t(1) : size_t(0);
+	}) && is_ok;
+
+	is_ok = run_benchmark(image, options, "relocation_sites", 0, -1, [&](const PatternScanner& scanner) {
+		return scanner.get_relocation_sites().size();
+	}, image.pe->get_relocations().size()) && is_ok;
+
+	// string xrefs check every candidate pointer this way, compared with searching the section list
+	std::vector<uint32_t> addresses(1 << 20);
+	Random random(options.seed);
+	const uint64_t image_base = image.pe->image_base;
+	for (auto& address : addresses)
+		address = image_base - 0x10000 + random.below(image.pe->image_size + 0x20000);
+
+	size_t rdata_addresses = 0;
+	for (uint32_t address : addresses) {
+		for (const auto& section : image.pe->get_sections()) {
+			if ((section.characteristics & PEImage::section_readable)
+				&& !(section.characteristics & (PEImage::section_executable | PEImage::section_writable))
+				&& address - (image_base + section.virtual_address) < image.pe->section_data_size(section)) {
+				rdata_addresses++;
+				break;
+			}
+		}
+	}
+
+	is_ok = run_benchmark(image, options, "is_in_rdata_segment", 0, static_cast<long long>(rdata_addresses), [&](const PatternScanner& scanner) {
+		size_t found = 0;
+		for (uint32_t address : addresses)
+			found += scanner.is_in_rdata_segment(address);
+		return found;
+	}, addresses.size()) && is_ok;
+
+	is_ok = run_benchmark(image, options, "is_in_rdata_segment_linear", 0, static_cast<long long>(rdata_addresses), [&](const PatternScanner&) {
+		size_t found = 0;
+		const auto& sections = image.pe->get_sections();
+		for (uint32_t address : addresses) {
+			for (const auto& section : sections) {
+				if ((section.characteristics & PEImage::section_readable)
+					&& !(section.characteristics & (PEImage::section_executable | PEImage::section_writable))
+					&& address - (image_base + section.virtual_address) < image.pe->section_data_size(section)) {
+					found++;
+					break;
+				}
+			}
+		}
+		return found;
+	}, addresses.size()) && is_ok;
+
+	// everything H2ToolHooks::hook scans for on a cold cache
+	is_ok = run_benchmark(image, options, "hook_total", code_bytes + rdata_bytes, -1, [&](const PatternScanner& scanner) {
+		size_t matches = 0;
+		if (const auto asserts = find_asserts_single_pass(scanner))
+			matches += 1 + *asserts;
+		if (scanner.find_pattern_in_rdata(cuban_lightmap_setting))
+			matches++;
+		return matches;
+	}) && is_ok;
+
+	return is_ok;
+}
+
+/*
+	Differential checks for --verify, each one prints a JSON line and returns false if the fast path disagrees with the slow one
+*/
+
+static void print_verify_result(const char* image_name, const std::string& check, size_t expected, size_t found, bool is_ok)
+{
+	std::string escaped_name;
+	escape_json(image_name, escaped_name);
+	printf("{\"image\":\"%s\",\"verify\":\"%s\",\"expected\":%zu,\"found\":%zu,\"ok\":%s}\n",
+		escaped_name.c_str(), check.c_str(), expected, found, is_ok ? "true" : "false");
+	fflush(stdout);
+}
+
+static std::vector<image_address> match_offsets(std::vector<PatternScanner::Match> matches)
+{
+	std::vector<image_address> offsets;
+	for (const auto& match : matches)
+		offsets.push_back(match.offset);
+	// the call site path finds them in call order
+	std::sort(offsets.begin(), offsets.end());
+	return offsets;
+}
+
+/*
+	Tries `pattern` at every address of the code or rdata sections with match_pattern_at_address, which runs it without any
+	prefilter, relocation or call site lookup, and compares that with every way of scanning for it
+*/
+template <typename Pattern>
+static bool verify_pattern(const Image& image, const Options& options, const char* name, const Pattern& pattern, bool is_code)
+{
+	const PatternScanner scanner(*image.pe);
+	std::vector<image_address> expected;
+	for (const auto& section : image.pe->get_sections()) {
+		const bool is_executable = (section.characteristics & PEImage::section_executable) != 0;
+		const bool is_rdata = (section.characteristics & PEImage::section_readable) && !(section.characteristics & (PEImage::section_executable | PEImage::section_writable));
+		if (is_code ? !is_executable : !is_rdata)
+			continue;
+		const image_address start = image.pe->image_base + section.virtual_address;
+		for (image_address address = start; address < start + section.virtual_size; address++) {
+			if (scanner.match_pattern_at_address(pattern, address))
+				expected.push_back(address);
+		}
+	}
+
+	std::vector<std::pair<const char*, std::vector<image_address>>> results;
+	if (is_code) {
+		results.push_back({ "scan", match_offsets(PatternScanner(*image.pe).find_pattern_in_code_multiple(pattern)) });
+		results.push_back({ "parallel", match_offsets(PatternScanner(*image.pe).find_pattern_in_code_multiple_parallel(pattern, 0, options.thread_count)) });
+	}
+	// walked next to a pattern with candidates nearly everywhere, so the cursors have to step past each other
+	constexpr auto any_mov = make_pattern(PAT_BYTE(0x8B), PAT_ANY(1));
+	const PatternScanner multi_scanner(*image.pe);
+	const auto multi_matches = is_code
+		? multi_scanner.find_patterns_in_code(PatternScanner::search(any_mov), PatternScanner::search(pattern))
+		: multi_scanner.find_patterns_in_rdata(PatternScanner::search(any_mov), PatternScanner::search(pattern));
+	results.push_back({ "multi", match_offsets(multi_matches[1]) });
+
+	const PatternScanner lazy_scanner(*image.pe);
+	std::vector<PatternScanner::Match> lazy_matches;
+	if (is_code) {
+		for (const auto& match : lazy_scanner.find_pattern_matches_in_code(pattern))
+			lazy_matches.push_back(match);
+	}
+	else {
+		for (const auto& match : lazy_scanner.find_pattern_matches_in_rdata(pattern))
+			lazy_matches.push_back(match);
+	}
+	results.push_back({ "lazy", match_offsets(lazy_matches) });
+
+	bool is_ok = true;
+	for (const auto& result : results) {
+		const bool is_same = result.second == expected;
+		print_verify_result(image.name.c_str(), std::string(name) + "_" + result.first, expected.size(), result.second.size(), is_same);
+		is_ok = is_same && is_ok;
+	}
+	return is_ok;
+}
+
+/*
+	Random literals over random buffers made of a few byte values, so the anchors show up often and at every alignment.
+	Every position all the literals match at has to be a candidate, whether the search ends up in the AVX2, SSE2 or memchr loop.
+*/
+static bool verify_prefilter(const Options& options)
+{
+	Random random(options.seed);
+	size_t missed = 0;
+	size_t out_of_order = 0;
+	size_t expected_count = 0;
+	constexpr size_t case_count = 20000;
+	for (size_t i = 0; i < case_count; i++) {
+		struct Literal
+		{
+			uint32_t offset;
+			uint8_t value;
+		};
+		std::vector<Literal> literals;
+		uint32_t offset = random.below(4);
+		const size_t literal_count = 1 + random.below(8);
+		// sometimes a run long enough for the skip table
+		const bool is_run = random.below(2) == 0;
+		for (size_t j = 0; j < literal_count; j++) {
+			literals.push_back({ offset, static_cast<uint8_t>(0x40 + random.below(3)) });
+			offset += is_run ? 1 : 1 + random.below(12);
+		}
+		const uint32_t span = literals.back().offset + 1;
+
+		AnchorPrefilter prefilter;
+		for (const auto& literal : literals)
+			prefilter.add_literal(literal.offset, literal.value);
+		prefilter.build_skip_table();
+
+		// starts at every alignment and ends anywhere, so the vector loops and the tail are all hit
+		const size_t alignment = random.below(32);
+		std::vector<uint8_t> buffer(alignment + random.below(600) + span);
+		for (auto& value : buffer)
+			value = static_cast<uint8_t>(0x40 + random.below(3));
+		const uint8_t* data = buffer.data() + alignment;
+		const uint8_t* last = buffer.data() + buffer.size() - span + 1;
+
+		std::vector<const uint8_t*> candidates;
+		for (const uint8_t* candidate = prefilter.next_candidate(data, last); candidate < last; candidate = prefilter.next_candidate_after(candidate, last)) {
+			if (!candidates.empty() && candidate <= candidates.back())
+				out_of_order++;
+			candidates.push_back(candidate);
+		}
+		for (const uint8_t* position = data; position < last; position++) {
+			if (!std::all_of(literals.begin(), literals.end(), [position](const Literal& literal) { return position[literal.offset] == literal.value; }))
+				continue;
+			expected_count++;
+			if (!std::binary_search(candidates.begin(), candidates.end(), position))
+				missed++;
+		}
+	}
+
+	const bool is_ok = missed == 0 && out_of_order == 0;
+	print_verify_result("random", "prefilter_" + std::string(AnchorPrefilter::get_search_loop()), expected_count, expected_count - missed, is_ok);
+	return is_ok;
+}
+
+/*
+	Patches random bytes across pages with different protections, the protection of each page has to be what it was after
+	committing and after rolling back, and the pages have to be unprotected in runs no longer than the protection allows
+*/
+static bool verify_patch_runs(const Options& options)
+{
+	MemoryProtection& process = MemoryProtection::current_process();
+	const size_t page_size = process.get_page_size();
+	constexpr size_t page_count = 32;
+	const ProtectedImage target(page_size * page_count);
+	if (!target.data)
+		return false;
+
+#ifdef _WIN32
+	const uint32_t protections[] = { PAGE_EXECUTE_READ, PAGE_READONLY, PAGE_READWRITE };
+#else
+	const uint32_t protections[] = { PROT_READ | PROT_EXEC, PROT_READ, PROT_READ | PROT_WRITE };
+#endif
+	Random random(options.seed);
+	std::vector<uint32_t> page_protections(page_count);
+	for (size_t page = 0; page < page_count; page++) {
+		// runs of a few pages with the same protection
+		page_protections[page] = page > 0 && random.below(3) != 0 ? page_protections[page - 1] : protections[random.below(3)];
+		process.restore(reinterpret_cast<uintptr_t>(target.data) + page * page_size, page_size, page_protections[page]);
+	}
+
+	// what the memory should look like, later writes win
+	std::vector<uint8_t> expected(target.size, 0);
+	std::vector<bool> is_page_written(page_count);
+	CountingProtection protection(process);
+	PatchTransaction transaction(protection);
+	for (size_t i = 0; i < 200; i++) {
+		// some cross into the next page
+		const size_t size = 1 + random.below(16);
+		const size_t offset = random.below(static_cast<uint32_t>(target.size - size));
+		uint8_t bytes[16];
+		for (size_t j = 0; j < size; j++)
+			bytes[j] = static_cast<uint8_t>(1 + random.below(255));
+		transaction.write_bytes(reinterpret_cast<uintptr_t>(target.data) + offset, bytes, size);
+		memcpy(expected.data() + offset, bytes, size);
+		for (size_t page = offset / page_size; page <= (offset + size - 1) / page_size; page++)
+			is_page_written[page] = true;
+	}
+
+	// a run can't cross a change of protection, and can't be more than one per page written
+	size_t min_runs = 0;
+	size_t pages_written = 0;
+	for (size_t page = 0, previous = page_count; page < page_count; page++) {
+		if (!is_page_written[page])
+			continue;
+		pages_written++;
+		bool is_same_run = previous != page_count;
+		for (size_t between = previous + 1; is_same_run && between <= page; between++)
+			is_same_run = page_protections[between] == page_protections[previous];
+		min_runs += is_same_run ? 0 : 1;
+		previous = page;
+	}
+
+	auto protection_unchanged = [&]() {
+		for (size_t page = 0; page < page_count; page++) {
+			uint32_t page_protection;
+			if (process.query(reinterpret_cast<uintptr_t>(target.data) + page * page_size, page_protection) == 0 || page_protection != page_protections[page])
+				return false;
+		}
+		return true;
+	};
+
+	const bool is_committed = transaction.commit();
+	const size_t runs = protection.changes / 2;
+	const bool is_written = is_committed && memcmp(target.data, expected.data(), target.size) == 0 && transaction.verify();
+	const bool is_restored = protection_unchanged();
+	const bool is_rolled_back = transaction.rollback() && std::all_of(target.data, target.data + target.size, [](uint8_t value) { return value == 0; }) && protection_unchanged();
+	const bool is_ok = is_written && is_restored && is_rolled_back && protection.changes % 2 == 0 && runs >= min_runs && runs <= pages_written;
+	print_verify_result("protected_pages", "patch_page_runs", min_runs, runs, is_ok);
+	return is_ok;
+}
+
+/*
+	The instruction starts are swept a block at a time, starting a little before each block. Every code section is checked
+	against one sweep from its start, the blocks have to have fallen into step with it by the time they get to their own bytes.
+*/
+static bool verify_instruction_starts(const Image& image)
+{
+	const PatternScanner scanner(*image.pe);
+	// starts from the single sweep, how many of those the blocks found and how many starts only the blocks found
+	size_t expected = 0, found = 0, extra = 0;
+	for (const auto& section : image.pe->get_sections()) {
+		if (!(section.characteristics & PEImage::section_executable))
+			continue;
+		const uint8_t* data = image.pe->section_data(section);
+		const size_t size = image.pe->section_data_size(section);
+		const image_address start = image.pe->image_base + section.virtual_address;
+		std::vector<bool> is_start(size);
+		for (size_t offset = 0; offset < size;) {
+			const size_t length = InstructionLength::decode(data + offset, size - offset, image.pe->is_64bit);
+			is_start[offset] = length != 0;
+			offset += length != 0 ? length : 1;
+		}
+		// checked backwards so each block is swept from the address being looked up, not from the one before it
+		for (size_t offset = size; offset-- > 0;) {
+			const bool is_block_start = scanner.is_instruction_start(start + offset);
+			expected += is_start[offset];
+			found += is_start[offset] && is_block_start;
+			extra += !is_start[offset] && is_block_start;
+		}
+	}
+	const bool is_ok = found == expected && extra == 0;
+	print_verify_result(image.name.c_str(), "instruction_starts", expected, found + extra, is_ok);
+	return is_ok;
+}
+
+static bool verify_image(const Image& image, const Options& options)
+{
+	using namespace Signatures;
+	// common enough in the filler that the prefilter finds a lot of candidates and matches
+	constexpr auto mov_store = make_pattern(PAT_BYTES(2, { 0x8B, 0x45 }), PAT_ANY(1), PAT_BYTE(0x89));
+	bool is_ok = verify_pattern(image, options, "mov_store", mov_store, true);
+	is_ok = verify_instruction_starts(image) && is_ok;
+
+	std::string error;
+	if (image.pe->is_64bit) {
+		is_ok = verify_pattern(image, options, "hs_assert_x64", hs_assert_x64, true) && is_ok;
+		const auto hs_assert_x64_bytecode = BytecodePattern::compile(hs_assert_x64_text, {}, error);
+		is_ok = hs_assert_x64_bytecode && verify_pattern(image, options, "hs_assert_x64_bytecode", *hs_assert_x64_bytecode, true) && is_ok;
+
+		const PatternScanner target_scanner(*image.pe);
+		const auto hs_match = target_scanner.find_pattern_in_code(hs_assert_x64);
+		const auto display_assert = hs_match ? target_scanner.get_call_target(hs_match->offset + hs_match->length) : std::optional<image_address>{};
+		is_ok = display_assert && verify_pattern(image, options, "assert_x64", assert_x64_pat(*display_assert), true) && is_ok;
+		return is_ok;
+	}
+
+	is_ok = verify_pattern(image, options, "hs_assert", hs_assert, true) && is_ok;
+	const auto hs_assert_bytecode = BytecodePattern::compile(hs_assert_text, {}, error);
+	is_ok = hs_assert_bytecode && verify_pattern(image, options, "hs_assert_bytecode", *hs_assert_bytecode, true) && is_ok;
+	is_ok = verify_pattern(image, options, "cuban_lightmap_setting", cuban_lightmap_setting, false) && is_ok;
+
+	image_address display_assert, system_debugger_present;
+	const PatternScanner target_scanner(*image.pe);
+	is_ok = find_assert_call_targets(target_scanner, display_assert, system_debugger_present)
+		&& verify_pattern(image, options, "assert_pat", assert_pat(display_assert, system_debugger_present), true) && is_ok;
+	return is_ok;
+}
+
+static bool parse_number(const char* string, size_t& value)
+{
+	char* end;
+	value = strtoull(string, &end, 0);
+	return end != string && *end == '\0';
+}
+
+static bool parse_dump(const char* argument, bool is_code, std::vector<SectionDump>& dumps)
+{
+	// path:rva, the last colon is used so drive letters work
+	const std::string string = argument;
+	const size_t separator = string.rfind(':');
+	size_t rva;
+	if (separator == std::string::npos || separator == 0 || !parse_number(string.c_str() + separator + 1, rva) || rva == 0)
+		return false;
+	dumps.push_back({ string.substr(0, separator), static_cast<uint32_t>(rva), is_code });
+	return true;
+}
+
+static void print_usage(const char* program)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  --code-size <bytes>      size of the synthetic code section (default 32 MiB)\n"
+		"  --asserts <count>        assert sites planted in the synthetic image (default 2000)\n"
+		"  --seed <number>          seed for the synthetic image\n"
+		"  --iterations <count>     runs per benchmark, the median is reported (default 5)\n"
+		"  --threads <count>        threads for the parallel scan (default automatic)\n"
+		"  --executable <path>      also benchmark a tool executable on disk\n"
+		"  --base <address>         image base the section dumps were taken at (default 0x400000)\n"
+		"  --code <path>:<rva>      code section dump, can be repeated\n"
+		"  --rdata <path>:<rva>     read-only data section dump, can be repeated\n"
+		"  --no-relocations         leave the base relocations out of the synthetic image\n"
+		"  --duplicate-strings      put a second copy of the signature strings in the synthetic image\n"
+		"  --x64                    also benchmark a 64-bit synthetic image\n"
+		"  --no-synthetic           skip the synthetic image\n"
+		"  --verify                 check the scans against trying the patterns at every address instead of timing them,\n"
+		"                           on small 32 and 64-bit synthetic images unless --code-size is given\n",
+		program);
+}
+
+// ScannerBenchmark [options], exits with 1 if a planted match was missed or a scan disagreed with the check
+int main(int argc, char* argv[])
+{
+	Options options;
+	bool run_synthetic = true;
+	bool is_verify = false;
+	bool is_code_size_set = false;
+	for (int i = 1; i < argc; i++) {
+		const std::string argument = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		size_t number;
+		bool is_valid = true;
+		if (argument == "--no-synthetic") {
+			run_synthetic = false;
+			continue;
+		}
+		if (argument == "--no-relocations") {
+			options.relocations = false;
+			continue;
+		}
+		if (argument == "--duplicate-strings") {
+			options.duplicate_strings = true;
+			continue;
+		}
+		if (argument == "--x64") {
+			options.x64 = true;
+			continue;
+		}
+		if (argument == "--verify") {
+			is_verify = true;
+			continue;
+		}
+		if (!value) {
+			is_valid = false;
+		}
+		else if (argument == "--code-size") {
+			is_valid = parse_number(value, options.code_size);
+			is_code_size_set = true;
+		}
+		else if (argument == "--asserts") {
+			is_valid = parse_number(value, options.assert_count);
+		}
+		else if (argument == "--seed") {
+			is_valid = parse_number(value, number);
+			options.seed = static_cast<uint32_t>(number);
+		}
+		else if (argument == "--iterations") {
+			is_valid = parse_number(value, options.iterations) && options.iterations > 0;
+		}
+		else if (argument == "--threads") {
+			is_valid = parse_number(value, options.thread_count);
+		}
+		else if (argument == "--executable") {
+			options.executable = value;
+		}
+		else if (argument == "--base") {
+			is_valid = parse_number(value, number);
+			options.dump_image_base = static_cast<uint32_t>(number);
+		}
+		else if (argument == "--code" || argument == "--rdata") {
+			is_valid = parse_dump(value, argument == "--code", options.dumps);
+		}
+		else {
+			is_valid = false;
+		}
+
+		if (!is_valid) {
+			print_usage(argv[0]);
+			return 2;
+		}
+		i++;
+	}
+
+	// every address is tried for every pattern, which doesn't need a big image to find a disagreement
+	if (is_verify) {
+		options.x64 = true;
+		if (!is_code_size_set)
+			options.code_size = 0x100000;
+	}
+
+	std::vector<Image> images;
+	if (run_synthetic)
+		images.push_back(build_synthetic_image(options));
+	if (run_synthetic && options.x64)
+		images.push_back(build_synthetic_x64_image(options));
+	if (!options.executable.empty()) {
+		auto image = load_executable(options.executable);
+		if (!image)
+			return 2;
+		images.push_back(std::move(*image));
+	}
+	if (!options.dumps.empty()) {
+		auto image = build_dump_image(options);
+		if (!image)
+			return 2;
+		images.push_back(std::move(*image));
+	}
+
+	bool is_ok = true;
+	if (is_verify) {
+		is_ok = verify_prefilter(options) && is_ok;
+		is_ok = verify_patch_runs(options) && is_ok;
+	}
+	for (const auto& image : images) {
+		if (!image.pe) {
+			fprintf(stderr, "Failed to parse %s\n", image.name.c_str());
+			return 2;
+		}
+		if (is_verify)
+			is_ok = verify_image(image, options) && is_ok;
+		else
+			is_ok = (image.pe->is_64bit ? benchmark_x64_image(image, options) : benchmark_image(image, options)) && is_ok;
+	}
+	return is_ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/*
+ Copyright (c) num0005. Some rights reserved
+ This software is part of the Osoyoos Launcher.
+ Released under the MIT License, see LICENSE.md for more information.
+*/
+
+/*
+	Offline signature scanner, resolves the H2ToolHooks signatures against a tool executable on disk.
+	Built by SignatureScanner.vcxproj on windows, elsewhere build it directly:
+		g++ -std=c++17 -O2 -I../H2ToolHooks SignatureScanner.cpp ../H2ToolHooks/PatternScanner.cpp ../H2ToolHooks/PEImage.cpp
+			../H2ToolHooks/MappedFile.cpp ../H2ToolHooks/AnchorPrefilter.cpp ../H2ToolHooks/BytecodePattern.cpp
+			../H2ToolHooks/ScanStats.cpp ../H2ToolHooks/InstructionLength.cpp ../H2ToolHooks/Logger.cpp -pthread -o SignatureScanner
+	Extra signatures can be scanned for from a file, one per line in the BytecodePattern text format:
+		code|rdata <name> = <pattern>
+	The patterns can call display_assert and system_debugger_present if hs_assert was found.
+*/
+
+#include "BytecodePattern.h"
+#include "PatternScanner.h"
+#include "PEImage.h"
+#include "MappedFile.h"
+#include "Signatures.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+static void print_matches(const char* name, const std::vector<PatternScanner::Match>& matches, image_address image_base)
+{
+	printf("%s: %zu", name, matches.size());
+	for (const auto& match : matches)
+		printf(" 0x%llx", static_cast<unsigned long long>(match.offset - image_base));
+	printf("\n");
+}
+
+/*
+	Scans for every signature in `path`, returns false if the file couldn't be read or has a bad signature in it
+*/
+static bool scan_signature_file(const PatternScanner& scanner, const char* path, const BytecodePattern::symbol_table& symbols)
+{
+	std::ifstream file(path);
+	if (!file) {
+		fprintf(stderr, "failed to open %s\n", path);
+		return false;
+	}
+
+	std::string line;
+	for (size_t line_number = 1; std::getline(file, line); line_number++) {
+		const size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#')
+			continue;
+
+		char section[0x10], name[0x100];
+		int pattern_start = 0;
+		if (sscanf(line.c_str(), " %15s %255s = %n", section, name, &pattern_start) != 2 || pattern_start == 0
+			|| (strcmp(section, "code") != 0 && strcmp(section, "rdata") != 0)) {
+			fprintf(stderr, "%s:%zu: expected 'code|rdata <name> = <pattern>'\n", path, line_number);
+			return false;
+		}
+
+		PatternScanner::StatsLabel label(scanner, name);
+		std::string error;
+		const auto pattern = BytecodePattern::compile(line.c_str() + pattern_start, symbols, error);
+		if (!pattern) {
+			fprintf(stderr, "%s:%zu: %s\n", path, line_number, error.c_str());
+			return false;
+		}
+
+		if (strcmp(section, "code") == 0) {
+			print_matches(name, scanner.find_pattern_in_code_multiple(*pattern), scanner.get_module_base());
+		}
+		else {
+			const auto match = scanner.find_pattern_in_rdata(*pattern);
+			print_matches(name, match ? std::vector<PatternScanner::Match>{ *match } : std::vector<PatternScanner::Match>{}, scanner.get_module_base());
+		}
+	}
+	return true;
+}
+
+// SignatureScanner <executable> [signature file]
+int main(int argc, char* argv[])
+{
+	if (argc != 2 && argc != 3) {
+		fprintf(stderr, "usage: %s <executable> [signature file]\n", argv[0]);
+		return 2;
+	}
+
+	MappedFile file(argv[1]);
+	if (!file.is_open()) {
+		fprintf(stderr, "failed to map %s\n", argv[1]);
+		return 2;
+	}
+
+	auto image = PEImage::parse(file.data(), file.size(), false);
+	if (!image) {
+		fprintf(stderr, "%s is not a PE image\n", argv[1]);
+		return 2;
+	}
+
+	const auto start_time = std::chrono::steady_clock::now();
+
+	PatternScanner scanner(*image);
+	const image_address image_base = scanner.get_module_base();
+	// the assert sites' call targets come from hs_assert, so every candidate site is found in the same pass
+	// and the ones calling display_assert and system_debugger_present are kept, same as disable_assertions
+	std::array<std::vector<PatternScanner::Match>, 2> code_matches;
+	{
+		PatternScanner::StatsLabel label(scanner, "hs_assert");
+		code_matches = scanner.find_patterns_in_code(PatternScanner::search(Signatures::hs_assert, 1), PatternScanner::search(Signatures::assert_candidate_pat));
+	}
+	const std::vector<PatternScanner::Match>& hs_matches = code_matches[0];
+	std::optional<PatternScanner::Match> cuban_match;
+	{
+		PatternScanner::StatsLabel label(scanner, "cuban_lightmap_setting");
+		cuban_match = scanner.find_pattern_in_rdata(Signatures::cuban_lightmap_setting);
+	}
+
+	std::vector<PatternScanner::Match> asserts;
+	BytecodePattern::symbol_table symbols;
+	if (!hs_matches.empty()) {
+		const image_address hs_assert_call_address = hs_matches[0].offset + hs_matches[0].length;
+		const auto display_assert = scanner.get_call_target(hs_assert_call_address);
+		const auto system_debugger_present = scanner.get_call_target(hs_assert_call_address + 0x3 + 0x5);
+		if (display_assert && system_debugger_present) {
+			for (const auto& candidate : code_matches[1]) {
+				if (Signatures::is_assert_site(scanner, candidate.offset, *display_assert, *system_debugger_present))
+					asserts.push_back(candidate);
+			}
+			symbols = { { "display_assert", *display_assert }, { "system_debugger_present", *system_debugger_present } };
+		}
+	}
+
+	const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time);
+
+	printf("image_base: 0x%llx\n", static_cast<unsigned long long>(image_base));
+	printf("timestamp: 0x%x\n", image->timestamp);
+	print_matches("hs_assert", hs_matches, image_base);
+	printf("assert_sites: %zu\n", asserts.size());
+	print_matches("cuban_lightmap_setting", cuban_match ? std::vector<PatternScanner::Match>{ *cuban_match } : std::vector<PatternScanner::Match>{}, image_base);
+	printf("scan_time_ms: %.3f\n", elapsed.count());
+
+	if (argc == 3 && !scan_signature_file(scanner, argv[2], symbols))
+		return 2;
+	scanner.print_stats();
+
+	return !hs_matches.empty() && cuban_match ? 0 : 1;
+}